@@ -0,0 +1,33 @@
+#include "demodulatortelemetry.h"
+
+#include <iomanip>
+#include <iostream>
+
+namespace DSP {
+
+void ConsoleTelemetry::report(const DemodulatorTelemetryData& data) {
+    std::cout << std::fixed << std::setprecision(2) << " Carrier: " << data.carrierFrequency << "Hz\t Lock detector: " << data.loopError << "\t isLocked: " << data.isLocked << "\t AGC: " << data.agcGain
+              << "\t OutputSize: " << data.symbolsOut * 2 / 1024.0f / 1024.0f << "Mb Progress: " << data.progress << "% \t\t\r" << std::flush;
+}
+
+void ConsoleTelemetry::finish() {
+    std::cout << std::endl;
+}
+
+JsonLinesTelemetry::JsonLinesTelemetry(const std::string& path)
+    : mStream(path, std::ios::out | std::ios::trunc) {}
+
+void JsonLinesTelemetry::report(const DemodulatorTelemetryData& data) {
+    if(!mStream.is_open()) {
+        return;
+    }
+
+    mStream << "{\"samplesIn\":" << data.samplesIn << ",\"symbolsOut\":" << data.symbolsOut << ",\"carrierHz\":" << data.carrierFrequency << ",\"loopError\":" << data.loopError
+            << ",\"locked\":" << (data.isLocked ? "true" : "false") << ",\"agcGain\":" << data.agcGain << ",\"timingError\":" << data.timingError << ",\"progress\":" << data.progress << "}\n";
+}
+
+void JsonLinesTelemetry::finish() {
+    mStream.flush();
+}
+
+} // namespace DSP
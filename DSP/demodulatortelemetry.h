@@ -0,0 +1,57 @@
+#ifndef DSP_DEMODULATORTELEMETRY_H
+#define DSP_DEMODULATORTELEMETRY_H
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+
+namespace DSP {
+
+struct DemodulatorTelemetryData {
+    float carrierFrequency; // Hz
+    float loopError;        // Filtered costas loop error, used as lock detector
+    bool isLocked;
+    float agcGain;
+    float timingError; // Last Mueller and Muller symbol timing error
+    uint64_t symbolsOut;
+    uint64_t samplesIn;
+    float progress; // %
+};
+
+class DemodulatorTelemetry {
+  public:
+    // Seconds of input signal between two reports
+    static constexpr float DEFAULT_INTERVAL = 0.5f;
+
+  public:
+    virtual ~DemodulatorTelemetry() {}
+
+    virtual void report(const DemodulatorTelemetryData& data) = 0;
+    virtual void finish() {}
+};
+
+class ConsoleTelemetry : public DemodulatorTelemetry {
+  public:
+    void report(const DemodulatorTelemetryData& data) override;
+    void finish() override;
+};
+
+class JsonLinesTelemetry : public DemodulatorTelemetry {
+  public:
+    JsonLinesTelemetry(const std::string& path);
+
+    bool isOpen() const {
+        return mStream.is_open();
+    }
+
+    void report(const DemodulatorTelemetryData& data) override;
+    void finish() override;
+
+  private:
+    std::ofstream mStream;
+};
+
+} // namespace DSP
+
+#endif // DSP_DEMODULATORTELEMETRY_H
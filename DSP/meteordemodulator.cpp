@@ -1,6 +1,5 @@
 #include "meteordemodulator.h"
 
-#include <iomanip>
 #include <iostream>
 
 #include "global.h"
@@ -16,6 +15,7 @@ MeteorDemodulator::MeteorDemodulator(MeteorCostas::Mode mode, float symbolRate,
     , mRrcFilterOrder(rrcFilterOrder)
     , mAgc(0.5f, 100)
     , mPrevI(0.0f)
+    , mTelemetryInterval(DemodulatorTelemetry::DEFAULT_INTERVAL)
     , mSamples(nullptr)
     , mProcessedSamples(nullptr) {
     mSamples = std::make_unique<PLL::complex[]>(STREAM_CHUNK_SIZE);
@@ -24,6 +24,12 @@ MeteorDemodulator::MeteorDemodulator(MeteorCostas::Mode mode, float symbolRate,
 
 MeteorDemodulator::~MeteorDemodulator() {}
 
+void MeteorDemodulator::addTelemetry(DemodulatorTelemetry* telemetry) {
+    if(telemetry != nullptr) {
+        mTelemetries.push_back(telemetry);
+    }
+}
+
 void MeteorDemodulator::process(IQSoruce& source, MeteorDecoderCallback_t callback) {
     float pllBandwidth = 2 * M_PI * mCostasBw / mSymbolRate;
     float maxFreqDeviation = 10000.0f * (2.0f * M_PI) / source.getSampleRate(); //+-10kHz
@@ -32,9 +38,29 @@ void MeteorDemodulator::process(IQSoruce& source, MeteorDecoderCallback_t callba
     MM mm(source.getSampleRate() / mSymbolRate, 1e-6, 0.01f, 0.01f);
     uint32_t readedSamples;
 
-    uint64_t bytesWrited = 0;
+    uint64_t symbolsWrited = 0;
+    uint64_t samplesReaded = 0;
+    const bool periodicTelemetry = !mTelemetries.empty() && mTelemetryInterval > 0;
+    const uint64_t telemetryIntervalSamples = periodicTelemetry ? static_cast<uint64_t>(mTelemetryInterval * source.getSampleRate()) : 0;
+    uint64_t nextTelemetrySample = 0;
     float progress = 0;
 
+    auto reportTelemetry = [&]() {
+        DemodulatorTelemetryData data;
+        data.carrierFrequency = costas.getFrequency() / (2 * M_PI) * source.getSampleRate();
+        data.loopError = costas.getError();
+        data.isLocked = costas.isLocked();
+        data.agcGain = mAgc.getGain();
+        data.timingError = mm.getTimingError();
+        data.symbolsOut = symbolsWrited;
+        data.samplesIn = samplesReaded;
+        data.progress = progress;
+
+        for(DemodulatorTelemetry* telemetry : mTelemetries) {
+            telemetry->report(data);
+        }
+    };
+
     if(mSamples == nullptr || mProcessedSamples == nullptr) {
         std::cout << "MeteorDecoder memory allocation is failed, skipping process" << std::endl;
         return;
@@ -44,28 +70,36 @@ void MeteorDemodulator::process(IQSoruce& source, MeteorDecoderCallback_t callba
     readedSamples = source.read(mSamples.get(), mRrcFilterOrder);
     mAgc.process(mSamples.get(), mProcessedSamples.get(), readedSamples);
     rrcFilter.process(mProcessedSamples.get(), mProcessedSamples.get(), readedSamples);
+    samplesReaded += readedSamples;
 
     while((readedSamples = source.read(mSamples.get(), STREAM_CHUNK_SIZE)) > 0) {
         mAgc.process(mSamples.get(), mProcessedSamples.get(), readedSamples);
         rrcFilter.process(mProcessedSamples.get(), mProcessedSamples.get(), readedSamples);
         costas.process(mProcessedSamples.get(), mProcessedSamples.get(), readedSamples);
 
-        mm.process(readedSamples, mProcessedSamples.get(), [progress, &bytesWrited, callback, &costas, this](MM::complex value) mutable {
+        mm.process(readedSamples, mProcessedSamples.get(), [progress, &symbolsWrited, callback, &costas, this](MM::complex value) mutable {
             // Append the new samples to the output file
             if(callback != nullptr && (!mWaitForLock || costas.isLockedOnce())) {
                 callback(value, progress);
             }
-            bytesWrited += 2;
+            symbolsWrited++;
         });
+        samplesReaded += readedSamples;
         progress = (source.getReadedSamples() / static_cast<float>(source.getTotalSamples())) * 100;
 
-        float carierFreq = costas.getFrequency() / (2 * M_PI) * source.getSampleRate();
+        if(periodicTelemetry && samplesReaded >= nextTelemetrySample) {
+            nextTelemetrySample = samplesReaded + telemetryIntervalSamples;
+            reportTelemetry();
+        }
+    }
 
-        std::cout << std::fixed << std::setprecision(2) << " Carrier: " << carierFreq << "Hz\t Lock detector: " << costas.getError() << "\t isLocked: " << costas.isLocked() << "\t OutputSize: " << bytesWrited / 1024.0f / 1024.0f
-                  << "Mb Progress: " << progress << "% \t\t\r" << std::flush;
+    if(!mTelemetries.empty()) {
+        reportTelemetry();
     }
 
-    std::cout << std::endl;
+    for(DemodulatorTelemetry* telemetry : mTelemetries) {
+        telemetry->finish();
+    }
 }
 
 } // namespace DSP
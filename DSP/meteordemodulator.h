@@ -1,9 +1,12 @@
 #ifndef METEORDEMODULATOR_H
 #define METEORDEMODULATOR_H
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include "agc.h"
+#include "demodulatortelemetry.h"
 #include "filter.h"
 #include "iqsource.h"
 #include "meteorcostas.h"
@@ -26,6 +29,18 @@ class MeteorDemodulator {
 
     void process(IQSoruce& source, MeteorDecoderCallback_t callback);
 
+    // Telemetry sinks are not owned, interval is given in seconds of input signal, <= 0 only sends the final report
+    void addTelemetry(DemodulatorTelemetry* telemetry);
+    void setTelemetryInterval(float seconds) {
+        mTelemetryInterval = seconds;
+    }
+
+    // Soft bits of a demodulated symbol in the .S file layout, imaginary part first
+    static void symbolToSoftBits(const PLL::complex& sample, int8_t* softBits) {
+        softBits[0] = static_cast<int8_t>(std::clamp(std::imag(sample) * 127.0f, -128.0f, 127.0f));
+        softBits[1] = static_cast<int8_t>(std::clamp(std::real(sample) * 127.0f, -128.0f, 127.0f));
+    }
+
   private:
     MeteorCostas::Mode mMode;
     bool mBorkenM2Modulation;
@@ -35,6 +50,8 @@ class MeteorDemodulator {
     uint16_t mRrcFilterOrder;
     Agc mAgc;
     float mPrevI;
+    float mTelemetryInterval;
+    std::vector<DemodulatorTelemetry*> mTelemetries;
     std::unique_ptr<PLL::complex[]> mSamples;
     std::unique_ptr<PLL::complex[]> mProcessedSamples;
 };
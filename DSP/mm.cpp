@@ -20,6 +20,7 @@ MM::MM(float omega, float omegaGain, float muGain, float omegaRelLimit, int inte
     , mc1T(0.0f, 0.0f)
     , mc2T(0.0f, 0.0f)
     , mOffset(0)
+    , mTimingError(0.0f)
     , mBuffer(new complex[interpTapCount + (STREAM_CHUNK_SIZE)])
     , mpBufStart(&mBuffer[interpTapCount - 1])
     , mInterpBank() {
@@ -58,6 +59,7 @@ int MM::process(int count, const complex* in, std::function<void(complex)> callb
 
         // Clamp symbol phase error
         error = std::clamp(error, -1.0f, 1.0f);
+        mTimingError = error;
 
         // Advance symbol mOffset and phase
         mPcl.advance(error);
@@ -18,6 +18,10 @@ class MM {
 
     int process(int count, const complex* in, std::function<void(complex)> callback);
 
+    float getTimingError() const {
+        return mTimingError;
+    }
+
   protected:
     void generateInterpTaps();
 
@@ -34,6 +38,7 @@ class MM {
     complex mc2T;
 
     int mOffset;
+    float mTimingError;
     std::unique_ptr<complex[]> mBuffer;
     complex* mpBufStart;
     PolyphaseBank<float> mInterpBank;
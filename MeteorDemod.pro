@@ -33,9 +33,16 @@ SOURCES += \
     decoder/meteorimage.cpp \
     decoder/packetparser.cpp \
     decoder/reedsolomon.cpp \
+    decoder/framedescrambler.cpp \
     decoder/bitio.cpp \
     decoder/correlation.cpp \
     decoder/meteordecoder.cpp \
+    decoder/configdetector.cpp \
+    decoder/decoderstats.cpp \
+    decoder/caduindex.cpp \
+    decoder/framejournal.cpp \
+    decoder/packedsoftbits.cpp \
+    decoder/idct8x8.cpp \
     imageproc/spreadimage.cpp \
     imageproc/threatimage.cpp \
     common/settings.cpp \
@@ -43,6 +50,8 @@ SOURCES += \
     tools/iniparser.cpp \
     tools/pixelgeolocationcalculator.cpp \
     tools/threadpool.cpp \
+    tools/memorymappedfile.cpp \
+    tools/cpufeatures.cpp \
     tools/tlereader.cpp \
     tools/matrix.cpp \
     tools/vector.cpp \
@@ -51,6 +60,7 @@ SOURCES += \
     DSP/filter.cpp \
     DSP/iqsource.cpp \
     DSP/meteordemodulator.cpp \
+    DSP/demodulatortelemetry.cpp \
     DSP/wavreader.cpp \
     DSP/mm.cpp
 
@@ -79,6 +89,13 @@ HEADERS += \
     decoder/bitio.h \
     decoder/correlation.h \
     decoder/reedsolomon.h \
+    decoder/framedescrambler.h \
+    decoder/configdetector.h \
+    decoder/decoderstats.h \
+    decoder/caduindex.h \
+    decoder/framejournal.h \
+    decoder/packedsoftbits.h \
+    decoder/idct8x8.h \
     imageproc/spreadimage.h \
     imageproc/threatimage.h \
     common/settings.h \
@@ -88,6 +105,8 @@ HEADERS += \
     tools/pixelgeolocationcalculator.h \
     tools/matrix.h \
     tools/threadpool.h \
+    tools/memorymappedfile.h \
+    tools/cpufeatures.h \
     tools/tlereader.h \
     tools/vector.h \
     tools/databuffer.h \
@@ -95,6 +114,7 @@ HEADERS += \
     DSP/filter.h \
     DSP/iqsource.h \
     DSP/meteordemodulator.h \
+    DSP/demodulatortelemetry.h \
     DSP/wavreader.h \
     DSP/mm.h
 
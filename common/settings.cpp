@@ -5,6 +5,7 @@
 #include <regex>
 #include <sstream>
 
+#include "DSP/demodulatortelemetry.h"
 #include "version.h"
 
 #if defined(_MSC_VER)
@@ -24,7 +25,7 @@ Settings& Settings::getInstance() {
 Settings::Settings() {
     mSettingsList.push_back(SettingsData("--help", "-h", "Print help"));
     mSettingsList.push_back(SettingsData("--tle", "-t", "TLE file required for pass calculation"));
-    mSettingsList.push_back(SettingsData("--input", "-i", "Input S file containing softbits"));
+    mSettingsList.push_back(SettingsData("--input", "-i", "Input S file containing softbits, packed .sp file, .wav file or .frames journal"));
     mSettingsList.push_back(SettingsData("--output", "-o", "Output folder where generated files will be placed"));
     mSettingsList.push_back(SettingsData("--date", "-d", "Specify pass date, format should be dd-mm-yyyy"));
     mSettingsList.push_back(SettingsData("--format", "-f", "Output image format (bmp, jpg)"));
@@ -33,6 +34,8 @@ Settings::Settings() {
     mSettingsList.push_back(SettingsData("--diff", "-diff", "Use differential decoding (Maybe required for newer satellites)"));
     mSettingsList.push_back(SettingsData("--int", "-int", "Deinterleave (Maybe required for newer satellites)"));
     mSettingsList.push_back(SettingsData("--brokenM2", "-b", "Broken M2 modulation"));
+    mSettingsList.push_back(SettingsData("--range", "-r", "Decode only the given time range of the recording in seconds, format should be start:end"));
+    mSettingsList.push_back(SettingsData("--auto", "-a", "Detect mode, differential decoding and deinterleaving from the beginning of the recording"));
     mSettingsList.push_back(SettingsData("--compmaxage", "-c", "Maximum image age in hours for creating composite image"));
     mSettingsList.push_back(SettingsData("--satellite", "-sat", "Name of the satellite settings in settings.ini file"));
 }
@@ -89,6 +92,35 @@ void Settings::parseIni(const std::string& path) {
     ini::extract(mIniParser.sections["Demodulator"]["CostasBandwidth"], mCostasBw, 50);
     ini::extract(mIniParser.sections["Demodulator"]["RRCFilterOrder"], mRRCFilterOrder, 64);
     ini::extract(mIniParser.sections["Demodulator"]["WaitForLock"], mWaitForLock, true);
+    ini::extract(mIniParser.sections["Demodulator"]["TelemetryInterval"], mTelemetryInterval, DSP::DemodulatorTelemetry::DEFAULT_INTERVAL);
+    ini::extract(mIniParser.sections["Demodulator"]["TelemetryFile"], mTelemetryFile);
+    ini::extract(mIniParser.sections["Demodulator"]["PackedSoftBits"], mPackedSoftBits, 0);
+    ini::extract(mIniParser.sections["Demodulator"]["AdaptiveSoftBitScaling"], mAdaptiveSoftBitScaling, true);
+
+    ini::extract(mIniParser.sections["Decoder"]["FrameDecodeThreads"], mFrameDecodeThreads, 0);
+    ini::extract(mIniParser.sections["Decoder"]["ContinuousViterbi"], mContinuousViterbi, false);
+    ini::extract(mIniParser.sections["Decoder"]["AutoDetectLength"], mAutoDetectLength, 45.0f);
+    ini::extract(mIniParser.sections["Decoder"]["StatsFile"], mStatsFile);
+    ini::extract(mIniParser.sections["Decoder"]["CaduIndex"], mCaduIndex, false);
+    ini::extract(mIniParser.sections["Decoder"]["FrameJournal"], mFrameJournal, false);
+    ini::extract(mIniParser.sections["Decoder"]["IntegerIDCT"], mIntegerIdct, false);
+    ini::extract(mIniParser.sections["Decoder"]["StatsInterval"], mStatsInterval, 0);
+    if(mStatsInterval < 0) {
+        // Would wrap around to billions of frames in the decoder, only the final statistics are written instead
+        mStatsInterval = 0;
+    }
+
+    std::string decodedChannels;
+    ini::extract(mIniParser.sections["Decoder"]["DecodedChannels"], decodedChannels);
+    std::istringstream decodedChannelsStream(decodedChannels);
+    std::string apid;
+    mDecodedChannels.clear();
+    while(std::getline(decodedChannelsStream, apid, ',')) {
+        int value;
+        if(ini::extract(apid, value, 0)) {
+            mDecodedChannels.push_back(value);
+        }
+    }
 
     ini::extract(mIniParser.sections["Treatment"]["FillBlackLines"], mFillBackLines, true);
 
@@ -310,6 +342,19 @@ bool Settings::differentialDecode() const {
     return result;
 }
 
+bool Settings::autoDetect() const {
+    bool result = false;
+
+    if(mArgs.count("--auto")) {
+        result = atoi(mArgs.at("--auto").c_str()) > 0;
+    }
+    if(mArgs.count("-a")) {
+        result = atoi(mArgs.at("-a").c_str()) > 0;
+    }
+
+    return result;
+}
+
 bool Settings::deInterleave() const {
     bool result = false;
 
@@ -323,6 +368,27 @@ bool Settings::deInterleave() const {
     return result;
 }
 
+bool Settings::getTimeRange(float& startSec, float& endSec) const {
+    std::string rangeStr;
+
+    if(mArgs.count("-r")) {
+        rangeStr = mArgs.at("-r");
+    }
+    if(mArgs.count("--range")) {
+        rangeStr = mArgs.at("--range");
+    }
+
+    size_t separator = rangeStr.find(':');
+    if(separator == std::string::npos) {
+        return false;
+    }
+
+    startSec = atof(rangeStr.substr(0, separator).c_str());
+    endSec = atof(rangeStr.substr(separator + 1).c_str());
+
+    return endSec > startSec;
+}
+
 bool Settings::getBrokenModulation() const {
     bool result = false;
 
@@ -1,6 +1,8 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <stdint.h>
+
 #include <list>
 #include <map>
 
@@ -96,6 +98,8 @@ class Settings {
     bool differentialDecode() const;
     bool deInterleave() const;
     bool getBrokenModulation() const;
+    bool autoDetect() const;
+    bool getTimeRange(float& startSec, float& endSec) const;
 
     bool showHelp() const {
         return mArgs.count("-h") > 0 || mArgs.count("--help") > 0;
@@ -192,6 +196,46 @@ class Settings {
     bool waitForlock() const {
         return mWaitForLock;
     }
+    float getTelemetryInterval() const {
+        return mTelemetryInterval;
+    }
+    const std::string& getTelemetryFile() const {
+        return mTelemetryFile;
+    }
+    int getPackedSoftBits() const {
+        return mPackedSoftBits;
+    }
+    bool adaptiveSoftBitScaling() const {
+        return mAdaptiveSoftBitScaling;
+    }
+
+    int getFrameDecodeThreads() const {
+        return mFrameDecodeThreads;
+    }
+    bool continuousViterbi() const {
+        return mContinuousViterbi;
+    }
+    float getAutoDetectLength() const {
+        return mAutoDetectLength;
+    }
+    const std::string& getStatsFile() const {
+        return mStatsFile;
+    }
+    uint32_t getStatsInterval() const {
+        return static_cast<uint32_t>(mStatsInterval);
+    }
+    bool caduIndex() const {
+        return mCaduIndex;
+    }
+    bool frameJournal() const {
+        return mFrameJournal;
+    }
+    bool integerIdct() const {
+        return mIntegerIdct;
+    }
+    const std::list<int>& getDecodedChannels() const {
+        return mDecodedChannels;
+    }
 
     bool fillBackLines() const {
         return mFillBackLines;
@@ -321,6 +365,21 @@ class Settings {
     int mCostasBw;
     int mRRCFilterOrder;
     bool mWaitForLock;
+    float mTelemetryInterval;
+    std::string mTelemetryFile;
+    int mPackedSoftBits;
+    bool mAdaptiveSoftBitScaling;
+
+    // ini section: Decoder
+    int mFrameDecodeThreads;
+    bool mContinuousViterbi;
+    float mAutoDetectLength;
+    std::string mStatsFile;
+    int mStatsInterval;
+    bool mCaduIndex;
+    bool mFrameJournal;
+    bool mIntegerIdct;
+    std::list<int> mDecodedChannels;
 
     // ini section: Treatment
     bool mFillBackLines;
@@ -1,25 +1,18 @@
 #include "bitio.h"
 
-BitIOConst::BitIOConst(const uint8_t* bytes)
+BitIOConst::BitIOConst(const uint8_t* bytes, int length)
     : mpBytes(bytes)
-    , mPos(0) {}
+    , mpEnd(bytes + (length > 0 ? length : 0))
+    , mBuffer(0)
+    , mBitCount(0) {}
 
-uint32_t BitIOConst::peekBits(int n) {
-    uint32_t result = 0;
-    for(int i = 0; i < n; i++) {
-        int p = mPos + i;
-        int bit = (mpBytes[p >> 3] >> (7 - (p & 7))) & 1;
-        result = (result << 1) | bit;
+void BitIOConst::refillTail() {
+    while(mBitCount <= 56) {
+        uint64_t byte = 0;
+        if(mpBytes < mpEnd) {
+            byte = *mpBytes++;
+        }
+        mBuffer |= byte << (56 - mBitCount);
+        mBitCount += 8;
     }
-    return result;
-}
-
-void BitIOConst::advanceBits(int n) {
-    mPos += n;
-}
-
-uint32_t BitIOConst::fetchBits(int n) {
-    uint32_t result = peekBits(n);
-    advanceBits(n);
-    return result;
 }
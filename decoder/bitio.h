@@ -4,18 +4,66 @@
 // Based on: https://github.com/artlav/meteor_decoder/blob/master/alib/bitop.pas
 
 #include <stdint.h>
+#include <string.h>
 
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
+// MSB first bit reader with a 64 bit buffer, refilled a whole word at a time.
+// At least 56 bits are available after a refill, bits past the end of the data read as zeros
 class BitIOConst {
   public:
-    BitIOConst(const uint8_t* bytes);
+    BitIOConst(const uint8_t* bytes, int length);
+
+    // n <= 32
+    uint32_t peekBits(int n) {
+        refill();
+        // Two shifts, so n == 0 does not shift by 64
+        return static_cast<uint32_t>((mBuffer >> 1) >> (63 - n));
+    }
+
+    void advanceBits(int n) {
+        mBuffer <<= n;
+        mBitCount -= n;
+    }
+
+    uint32_t fetchBits(int n) {
+        uint32_t result = peekBits(n);
+        advanceBits(n);
+        return result;
+    }
+
+  private:
+    void refill() {
+        if(mpEnd - mpBytes >= 8) {
+            mBuffer |= loadBigEndian(mpBytes) >> mBitCount;
+            mpBytes += (63 - mBitCount) >> 3;
+            mBitCount |= 56;
+        } else {
+            refillTail();
+        }
+    }
+
+    void refillTail();
 
-    uint32_t peekBits(int n);
-    void advanceBits(int n);
-    uint32_t fetchBits(int n);
+    static uint64_t loadBigEndian(const uint8_t* bytes) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+#if defined(_MSC_VER)
+        return _byteswap_uint64(word);
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return word;
+#else
+        return __builtin_bswap64(word);
+#endif
+    }
 
   private:
     const uint8_t* mpBytes;
-    int mPos;
+    const uint8_t* mpEnd;
+    uint64_t mBuffer;
+    int mBitCount;
 };
 
 
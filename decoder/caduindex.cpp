@@ -0,0 +1,83 @@
+#include "caduindex.h"
+
+#include <fstream>
+
+CaduIndex::CaduIndex()
+    : header() {
+    header.magic = MAGIC;
+    header.version = VERSION;
+}
+
+bool CaduIndex::load(const std::string& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if(!stream.is_open()) {
+        return false;
+    }
+
+    Header fileHeader;
+    stream.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+    if(stream.gcount() != sizeof(fileHeader) || fileHeader.magic != MAGIC || fileHeader.version != VERSION) {
+        return false;
+    }
+
+    // A truncated or corrupt file must not allocate more entries than it can hold
+    const std::streamoff entriesStart = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    const std::streamoff fileSize = stream.tellg();
+    stream.seekg(entriesStart);
+    if(!stream || fileSize < entriesStart || fileHeader.frameCount > static_cast<uint64_t>(fileSize - entriesStart) / ENTRY_SIZE) {
+        return false;
+    }
+
+    std::vector<Entry> fileEntries(fileHeader.frameCount);
+    for(Entry& entry : fileEntries) {
+        stream.read(reinterpret_cast<char*>(&entry.pos), sizeof(entry.pos));
+        stream.read(reinterpret_cast<char*>(&entry.phaseShift), sizeof(entry.phaseShift));
+        stream.read(reinterpret_cast<char*>(&entry.inputPos), sizeof(entry.inputPos));
+    }
+    if(!stream) {
+        return false;
+    }
+
+    header = fileHeader;
+    entries.swap(fileEntries);
+    return true;
+}
+
+bool CaduIndex::save(const std::string& path) const {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if(!stream.is_open()) {
+        return false;
+    }
+
+    Header fileHeader = header;
+    fileHeader.frameCount = entries.size();
+    stream.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+
+    for(const Entry& entry : entries) {
+        stream.write(reinterpret_cast<const char*>(&entry.pos), sizeof(entry.pos));
+        stream.write(reinterpret_cast<const char*>(&entry.phaseShift), sizeof(entry.phaseShift));
+        stream.write(reinterpret_cast<const char*>(&entry.inputPos), sizeof(entry.inputPos));
+    }
+
+    return static_cast<bool>(stream);
+}
+
+bool CaduIndex::matches(uint64_t softBitsLength, bool oqpsk, bool differentialDecode, bool deInterleave) const {
+    return header.softBitsLength == softBitsLength && (header.oqpsk != 0) == oqpsk && (header.differentialDecode != 0) == differentialDecode && (header.deInterleave != 0) == deInterleave;
+}
+
+std::vector<CaduIndex::Entry> CaduIndex::getEntries(float startSec, float endSec) const {
+    // Two soft bits per symbol
+    const double softBitsPerSec = header.symbolRate * 2.0;
+    std::vector<Entry> result;
+
+    for(const Entry& entry : entries) {
+        const double sec = entry.inputPos / softBitsPerSec;
+        if(sec >= startSec && sec < endSec) {
+            result.push_back(entry);
+        }
+    }
+
+    return result;
+}
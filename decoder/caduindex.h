@@ -0,0 +1,60 @@
+#ifndef CADUINDEX_H
+#define CADUINDEX_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Sidecar file of a .S recording with the confirmed CADU positions, written after the first decode.
+// Positions are soft bit offsets of the stream the correlator works on, so after deinterleaving when it is enabled.
+// Time ranges are selected on the input position, the soft bit offset in the recording itself
+class CaduIndex {
+  public:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        float symbolRate;
+        uint8_t oqpsk;
+        uint8_t differentialDecode;
+        uint8_t deInterleave;
+        uint8_t reserved;
+        int64_t captureTime; // DateTime ticks
+        uint64_t softBitsLength;
+        uint64_t frameCount;
+    };
+
+    struct Entry {
+        uint64_t pos;
+        uint16_t phaseShift;
+        uint64_t inputPos;
+    };
+
+  public:
+    CaduIndex();
+
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // The index can only be used with the recording and decoder settings it was made with
+    bool matches(uint64_t softBitsLength, bool oqpsk, bool differentialDecode, bool deInterleave) const;
+
+    // Entries whose frame starts in [startSec, endSec) of the recording
+    std::vector<Entry> getEntries(float startSec, float endSec) const;
+
+  public:
+    Header header;
+    std::vector<Entry> entries;
+
+  public:
+    static std::string pathFor(const std::string& softBitsPath) {
+        return softBitsPath + ".idx";
+    }
+
+  private:
+    static constexpr uint32_t MAGIC = 0x5844494D; // "MIDX"
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint64_t ENTRY_SIZE = sizeof(Entry::pos) + sizeof(Entry::phaseShift) + sizeof(Entry::inputPos);
+};
+
+#endif // CADUINDEX_H
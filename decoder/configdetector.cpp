@@ -0,0 +1,148 @@
+#include "configdetector.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+#include "DSP/meteordemodulator.h"
+#include "DSP/wavreader.h"
+#include "meteordecoder.h"
+
+namespace {
+
+// Ends the wrapped source after the given number of samples
+class PrefixSource : public DSP::IQSoruce {
+  public:
+    PrefixSource(DSP::IQSoruce& source, uint32_t samples)
+        : mSource(source) {
+        mBitsPerSample = source.getBitsPerSample();
+        mSampleRate = source.getSampleRate();
+        mTotalSamples = std::min(samples, source.getTotalSamples());
+    }
+
+    uint32_t read(complex* data, uint32_t len) override {
+        len = std::min(len, mTotalSamples - mReadedSamples);
+        if(len == 0) {
+            return 0;
+        }
+
+        uint32_t readed = mSource.read(data, len);
+        mReadedSamples += readed;
+        return readed;
+    }
+
+  private:
+    DSP::IQSoruce& mSource;
+};
+
+} // namespace
+
+ConfigDetector::ConfigDetector(ThreadPool& threadPool, float symbolRate, float lengthSec)
+    : mThreadPool(threadPool)
+    , mSymbolRate(symbolRate)
+    , mLengthSec(lengthSec) {}
+
+bool ConfigDetector::detect(const uint8_t* softBits, size_t length, Configuration& result) {
+    length = std::min(length, getPrefixLength());
+
+    mCandidates.clear();
+    addCandidates(false, softBits, length);
+    addCandidates(true, softBits, length);
+
+    return evaluate(result);
+}
+
+bool ConfigDetector::detect(const std::string& wavPath, const DemodulatorSettings& demodulatorSettings, Configuration& result) {
+    std::vector<uint8_t> softBits[2];
+    const float lengthSec = mLengthSec;
+
+    ThreadPool::JobCounter jobs;
+    for(int oqpsk = 0; oqpsk < 2; oqpsk++) {
+        std::vector<uint8_t>& output = softBits[oqpsk];
+        mThreadPool.addJob([&wavPath, &demodulatorSettings, &output, oqpsk, lengthSec]() {
+            demodulatePrefix(wavPath, demodulatorSettings, oqpsk != 0, lengthSec, output);
+        }, jobs);
+    }
+    jobs.wait();
+
+    mCandidates.clear();
+    addCandidates(false, softBits[0].data(), softBits[0].size());
+    addCandidates(true, softBits[1].data(), softBits[1].size());
+
+    return evaluate(result);
+}
+
+void ConfigDetector::addCandidates(bool oqpsk, const uint8_t* softBits, size_t length) {
+    if(length == 0) {
+        return;
+    }
+
+    for(int differentialDecode = 0; differentialDecode < 2; differentialDecode++) {
+        for(int deInterleave = 0; deInterleave < 2; deInterleave++) {
+            Candidate candidate;
+            candidate.configuration.oqpsk = oqpsk;
+            candidate.configuration.differentialDecode = differentialDecode != 0;
+            candidate.configuration.deInterleave = deInterleave != 0;
+            candidate.softBits = softBits;
+            candidate.length = length;
+            candidate.syncWords = 0;
+            candidate.packets = 0;
+            mCandidates.push_back(candidate);
+        }
+    }
+}
+
+bool ConfigDetector::evaluate(Configuration& result) {
+    ThreadPool::JobCounter jobs;
+    for(Candidate& candidate : mCandidates) {
+        mThreadPool.addJob([&candidate]() {
+            decodeCandidate(candidate);
+        }, jobs);
+    }
+    jobs.wait();
+
+    const Candidate* best = nullptr;
+    for(const Candidate& candidate : mCandidates) {
+        std::cout << "Mode:" << (candidate.configuration.oqpsk ? "oqpsk" : "qpsk") << " | Diff:" << candidate.configuration.differentialDecode << " | Int:" << candidate.configuration.deInterleave
+                  << " | SyncWordFound:" << candidate.syncWords << " | Decoded Packets:" << candidate.packets << std::endl;
+
+        if(best == nullptr || candidate.packets > best->packets || (candidate.packets == best->packets && candidate.syncWords > best->syncWords)) {
+            best = &candidate;
+        }
+    }
+
+    // Sync words alone are found with a wrong differential setting too
+    if(best == nullptr || best->packets == 0) {
+        return false;
+    }
+
+    result = best->configuration;
+    return true;
+}
+
+void ConfigDetector::decodeCandidate(Candidate& candidate) {
+    auto decoder = std::make_unique<MeteorDecoder>(candidate.configuration.deInterleave, candidate.configuration.oqpsk, candidate.configuration.differentialDecode);
+    decoder->setVerbose(false);
+
+    candidate.packets = decoder->decode(candidate.softBits, candidate.length);
+    candidate.syncWords = decoder->getSyncWordCount();
+}
+
+void ConfigDetector::demodulatePrefix(const std::string& wavPath, const DemodulatorSettings& demodulatorSettings, bool oqpsk, float lengthSec, std::vector<uint8_t>& softBits) {
+    Wavreader wavReader;
+    if(!wavReader.openFile(wavPath)) {
+        return;
+    }
+
+    PrefixSource source(wavReader, static_cast<uint32_t>(lengthSec * wavReader.getSampleRate()));
+    DSP::MeteorDemodulator demodulator(oqpsk ? DSP::MeteorCostas::OQPSK : DSP::MeteorCostas::QPSK, demodulatorSettings.symbolRate, demodulatorSettings.costasBandwidth, demodulatorSettings.rrcFilterOrder,
+                                       demodulatorSettings.waitForLock, demodulatorSettings.brokenModulation);
+
+    softBits.reserve(static_cast<size_t>(lengthSec * demodulatorSettings.symbolRate) * 2);
+    demodulator.process(source, [&softBits](const DSP::PLL::complex& sample, float) {
+        int8_t symbolSoftBits[2];
+        DSP::MeteorDemodulator::symbolToSoftBits(sample, symbolSoftBits);
+        softBits.push_back(static_cast<uint8_t>(symbolSoftBits[0]));
+        softBits.push_back(static_cast<uint8_t>(symbolSoftBits[1]));
+    });
+}
@@ -0,0 +1,66 @@
+#ifndef CONFIGDETECTOR_H
+#define CONFIGDETECTOR_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+
+// Decodes the beginning of a recording with every combination of mode, differential decoding and deinterleaving
+// on the thread pool and picks the one with the most Reed-Solomon corrected packets, sync words break the ties
+class ConfigDetector {
+  public:
+    struct Configuration {
+        bool oqpsk;
+        bool differentialDecode;
+        bool deInterleave;
+    };
+
+    struct DemodulatorSettings {
+        float symbolRate;
+        int costasBandwidth;
+        int rrcFilterOrder;
+        bool waitForLock;
+        bool brokenModulation;
+    };
+
+  public:
+    ConfigDetector(ThreadPool& threadPool, float symbolRate, float lengthSec);
+
+    // Soft bits of an already demodulated recording, only the first getPrefixLength() of them are used
+    bool detect(const uint8_t* softBits, size_t length, Configuration& result);
+
+    size_t getPrefixLength() const {
+        // Two soft bits per symbol
+        return static_cast<size_t>(mLengthSec * mSymbolRate) * 2;
+    }
+
+    // Demodulates the beginning of the .wav file with both modes first
+    bool detect(const std::string& wavPath, const DemodulatorSettings& demodulatorSettings, Configuration& result);
+
+  private:
+    struct Candidate {
+        Configuration configuration;
+        const uint8_t* softBits;
+        size_t length;
+        size_t syncWords;
+        size_t packets;
+    };
+
+  private:
+    void addCandidates(bool oqpsk, const uint8_t* softBits, size_t length);
+    bool evaluate(Configuration& result);
+
+    static void decodeCandidate(Candidate& candidate);
+    static void demodulatePrefix(const std::string& wavPath, const DemodulatorSettings& demodulatorSettings, bool oqpsk, float lengthSec, std::vector<uint8_t>& softBits);
+
+  private:
+    ThreadPool& mThreadPool;
+    float mSymbolRate;
+    float mLengthSec;
+    std::vector<Candidate> mCandidates;
+};
+
+#endif // CONFIGDETECTOR_H
@@ -1,5 +1,13 @@
 #include "correlation.h"
 
+#include <algorithm>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
 Correlation::Correlation(uint64_t syncWord, bool oqpsk)
     : mSyncWord(syncWord)
     , mOqpskMode(oqpsk) {
@@ -8,26 +16,177 @@ Correlation::Correlation(uint64_t syncWord, bool oqpsk)
 
 void Correlation::correlate(const uint8_t* softBits, int64_t size, CorrelationCallback callback) {
     CorellationResult result{};
+    PhaseShift phaseShift;
+    int64_t pos = 0;
+
+    while(findSync(&softBits[pos], size - pos, result, phaseShift)) {
+        pos += result.pos;
+        result.pos = pos;
+        pos += callback(result, phaseShift) + 1;
+    }
+}
+
+bool Correlation::findSync(const uint8_t* softBits, int64_t size, CorellationResult& result, PhaseShift& phaseShift) const {
+    static const SearchBlockFunction searchBlock = CpuFeatures::hasAVX2() ? searchBlockAVX2 : searchBlockScalar;
+
+    const int kernelCount = static_cast<int>(mKernelWords.size());
+    int kernel = 0;
+    int bitErrors = 0;
+
+    // Every block needs 63 soft bits more than the number of offsets it checks
+    for(int64_t blockStart = 0; blockStart < size - 64; blockStart += SEARCH_BLOCK_SIZE) {
+        const int64_t offsets = std::min(SEARCH_BLOCK_SIZE, size - 64 - blockStart);
+        const int64_t offset = searchBlock(&softBits[blockStart], offsets, mKernelWords.data(), kernelCount, 64 - CORRELATION_LIMIT, &kernel, &bitErrors);
+
+        if(offset >= 0) {
+            result.corr = 64 - bitErrors;
+            result.pos = static_cast<uint32_t>(blockStart + offset);
+            phaseShift = static_cast<PhaseShift>(kernel);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Correlation::findBestSync(const uint8_t* softBits, int64_t size, PhaseShift phaseShift, CorellationResult& result) const {
+    const uint64_t kernel = mKernelWords[phaseShift];
+    int bestErrors = 64 - CORRELATION_LIMIT + 1;
+
+    for(int64_t blockStart = 0; blockStart < size - 64; blockStart += SEARCH_BLOCK_SIZE) {
+        const int64_t offsets = std::min(SEARCH_BLOCK_SIZE, size - 64 - blockStart);
+        uint64_t words[SEARCH_BLOCK_WORDS] = {};
+        packBits(&softBits[blockStart], offsets + 63, words);
+
+        for(int64_t i = 0; i < offsets; i++) {
+            const int errors = countBits64(windowAt(words, i) ^ kernel);
+            if(errors < bestErrors) {
+                bestErrors = errors;
+                result.pos = static_cast<uint32_t>(blockStart + i);
+            }
+        }
+    }
+
+    if(bestErrors > 64 - CORRELATION_LIMIT) {
+        return false;
+    }
+
+    result.corr = 64 - bestErrors;
+    return true;
+}
+
+// Packs length soft bits into words, bit k of a word is set when the soft bit at position k is >= 127
+void Correlation::packBits(const uint8_t* softBits, int64_t length, uint64_t* words) {
+    for(int64_t i = 0; i < length; i += 64) {
+        const int64_t n = std::min<int64_t>(64, length - i);
+        uint64_t word = 0;
+        for(int64_t k = 0; k < n; k++) {
+            word |= static_cast<uint64_t>(softBits[i + k] >= 127) << k;
+        }
+        words[i / 64] = word;
+    }
+}
 
-    for(uint32_t i = 0; i < size - 64; i++) {
-        for(int n = 0; n < mKernels.size(); n++) {
-            int score = 0;
-            for(int k = 0; k < mKernels[n].size(); k++) {
-                score += hardCorrelate(softBits[i + k], mKernels[n][k]);
+int64_t Correlation::searchBlockScalar(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors) {
+    uint64_t words[SEARCH_BLOCK_WORDS] = {};
+    packBits(softBits, offsets + 63, words);
+
+    for(int64_t i = 0; i < offsets; i++) {
+        const uint64_t window = windowAt(words, i);
+
+        for(int n = 0; n < kernelCount; n++) {
+            const int errors = countBits64(window ^ kernels[n]);
+            if(errors <= maxBitErrors) {
+                *kernel = n;
+                *bitErrors = errors;
+                return i;
             }
-            result.pos = score > result.corr ? i : result.pos;
-            result.corr = score > result.corr ? score : result.corr;
-
-            if(result.corr >= CORRELATION_LIMIT) {
-                i += callback(result, n);
-                result.pos = 0;
-                result.corr = 0;
-                break;
+        }
+    }
+    return -1;
+}
+
+#if defined(CPU_FEATURES_X86)
+
+CPU_FEATURES_TARGET_AVX2 int64_t Correlation::searchBlockAVX2(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors) {
+    uint64_t words[SEARCH_BLOCK_WORDS] = {};
+    const int64_t length = offsets + 63;
+
+    // soft >= 127 is a signed compare against -2 once the sign bit is flipped
+    const __m256i signBit = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i threshold = _mm256_set1_epi8(126 ^ 0x80);
+    int64_t i = 0;
+    for(; i + 64 <= length; i += 64) {
+        __m256i low = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&softBits[i])), signBit);
+        __m256i high = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(&softBits[i + 32])), signBit);
+        uint32_t lowMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(low, threshold)));
+        uint32_t highMask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(high, threshold)));
+        words[i / 64] = lowMask | (static_cast<uint64_t>(highMask) << 32);
+    }
+    if(i < length) {
+        packBits(&softBits[i], length - i, &words[i / 64]);
+    }
+
+    const __m256i popCountTable = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i errorLimit = _mm256_set1_epi64x(maxBitErrors + 1);
+    const __m256i laneShift = _mm256_setr_epi64x(0, 1, 2, 3);
+    const __m256i sixtyFour = _mm256_set1_epi64x(64);
+
+    // Four consecutive offsets per iteration, they always share the same pair of words
+    int64_t offset = 0;
+    for(; offset + 4 <= offsets; offset += 4) {
+        const int64_t w = offset / 64;
+        const __m256i shift = _mm256_add_epi64(_mm256_set1_epi64x(offset % 64), laneShift);
+        // Shift counts of 64 produce zero, that covers the first offset of every word
+        const __m256i window = _mm256_or_si256(_mm256_srlv_epi64(_mm256_set1_epi64x(words[w]), shift), _mm256_sllv_epi64(_mm256_set1_epi64x(words[w + 1]), _mm256_sub_epi64(sixtyFour, shift)));
+
+        int hitMasks[16];
+        int anyHit = 0;
+        for(int n = 0; n < kernelCount; n++) {
+            const __m256i diff = _mm256_xor_si256(window, _mm256_set1_epi64x(kernels[n]));
+            const __m256i count = _mm256_add_epi8(_mm256_shuffle_epi8(popCountTable, _mm256_and_si256(diff, lowNibble)), _mm256_shuffle_epi8(popCountTable, _mm256_and_si256(_mm256_srli_epi16(diff, 4), lowNibble)));
+            const __m256i errors = _mm256_sad_epu8(count, _mm256_setzero_si256());
+            hitMasks[n] = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(errorLimit, errors)));
+            anyHit |= hitMasks[n];
+        }
+
+        if(anyHit) {
+            for(int lane = 0; lane < 4; lane++) {
+                for(int n = 0; n < kernelCount; n++) {
+                    if(hitMasks[n] & (1 << lane)) {
+                        const int64_t i = offset + lane;
+                        *kernel = n;
+                        *bitErrors = countBits64(windowAt(words, i) ^ kernels[n]);
+                        return i;
+                    }
+                }
             }
         }
     }
+
+    for(; offset < offsets; offset++) {
+        const uint64_t window = windowAt(words, offset);
+
+        for(int n = 0; n < kernelCount; n++) {
+            const int errors = countBits64(window ^ kernels[n]);
+            if(errors <= maxBitErrors) {
+                *kernel = n;
+                *bitErrors = errors;
+                return offset;
+            }
+        }
+    }
+    return -1;
 }
 
+#else
+
+int64_t Correlation::searchBlockAVX2(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors) {
+    return searchBlockScalar(softBits, offsets, kernels, kernelCount, maxBitErrors, kernel, bitErrors);
+}
+
+#endif
+
 void Correlation::initKernels() {
     mKernels.resize(8);
 
@@ -42,6 +201,14 @@ void Correlation::initKernels() {
             delayOQPSK(mKernels[i + 8].data(), mKernels[i + 8].size());
         }
     }
+
+    mKernelWords.resize(mKernels.size());
+    for(size_t n = 0; n < mKernels.size(); n++) {
+        mKernelWords[n] = 0;
+        for(int k = 0; k < 64; k++) {
+            mKernelWords[n] |= static_cast<uint64_t>(mKernels[n][k] == 0xFF) << k;
+        }
+    }
 }
 
 uint64_t Correlation::rotate64(uint64_t word, PhaseShift phaseShift) {
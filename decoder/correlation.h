@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #include <functional>
+#include <vector>
 
 class Correlation {
   public:
@@ -21,14 +22,30 @@ class Correlation {
     Correlation(uint64_t syncWord, bool oqpsk);
 
     void correlate(const uint8_t* softBits, int64_t size, CorrelationCallback callback);
+
+    // Finds the first position in [0, size - 64) where any kernel reaches the correlation limit
+    bool findSync(const uint8_t* softBits, int64_t size, CorellationResult& result, PhaseShift& phaseShift) const;
+
+    // Best match of a single kernel in [0, size - 64), used to track a known phase
+    bool findBestSync(const uint8_t* softBits, int64_t size, PhaseShift phaseShift, CorellationResult& result) const;
     uint64_t rotate64(uint64_t word, PhaseShift phaseShift);
 
   private:
-    void initKernels();
-    inline uint32_t hardCorrelate(uint8_t dataByte, uint8_t wordByte) const {
-        return (dataByte >= 127 & wordByte == 255) | (dataByte < 127 & wordByte == 0);
+    typedef int64_t (*SearchBlockFunction)(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors);
+
+    // Returns the first offset in [0, offsets) matching any kernel with at most maxBitErrors, -1 if there is none
+    static int64_t searchBlockScalar(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors);
+    static int64_t searchBlockAVX2(const uint8_t* softBits, int64_t offsets, const uint64_t* kernels, int kernelCount, int maxBitErrors, int* kernel, int* bitErrors);
+    static void packBits(const uint8_t* softBits, int64_t length, uint64_t* words);
+
+    static inline uint64_t windowAt(const uint64_t* words, int64_t offset) {
+        const int64_t w = offset / 64;
+        const int shift = offset % 64;
+        return shift == 0 ? words[w] : (words[w] >> shift) | (words[w + 1] << (64 - shift));
     }
 
+    void initKernels();
+
     inline void hardToSoft(uint64_t UW, uint8_t* const result) {
         for(int i = 0; i < 64; i++) {
             result[i] = (UW >> (64 - i - 1)) & 1 ? 0xFF : 0x00;
@@ -54,9 +71,13 @@ class Correlation {
     uint64_t mSyncWord;
     bool mOqpskMode;
     std::vector<std::vector<uint8_t>> mKernels;
+    // Hard sliced kernels, bit k is set when the kernel expects a soft bit >= 127 at position k
+    std::vector<uint64_t> mKernelWords;
 
   private:
     static constexpr uint8_t CORRELATION_LIMIT = 54;
+    static constexpr int64_t SEARCH_BLOCK_SIZE = 4096;
+    static constexpr int64_t SEARCH_BLOCK_WORDS = SEARCH_BLOCK_SIZE / 64 + 2;
 
   public:
     static void rotateSoftIqInPlace(uint8_t* data, uint32_t length, PhaseShift phaseShift);
@@ -66,6 +87,14 @@ class Correlation {
         i = (i & 0x33333333) + ((i >> 2) & 0x33333333);
         return (((i + (i >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
     }
+
+    static int countBits64(uint64_t i) {
+#if defined(__GNUC__)
+        return __builtin_popcountll(i);
+#else
+        return countBits(static_cast<uint32_t>(i)) + countBits(static_cast<uint32_t>(i >> 32));
+#endif
+    }
 };
 
 #endif // CORRELATION_H
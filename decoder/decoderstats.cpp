@@ -0,0 +1,50 @@
+#include "decoderstats.h"
+
+DecoderStats::DecoderStats() {
+    reset();
+}
+
+void DecoderStats::reset() {
+    mSyncWords = 0;
+    mSyncLosses = 0;
+    mFramesTried = 0;
+    mFramesPassed = 0;
+    mRsFailures = 0;
+    mRsCorrections.fill(0);
+    mPhaseShifts.fill(0);
+    mPackets.fill(0);
+    mMcus.fill(0);
+}
+
+uint64_t DecoderStats::getRsCorrectedSymbols() const {
+    uint64_t symbols = 0;
+    for(int i = 1; i <= RS_MAX_CORRECTIONS; i++) {
+        symbols += mRsCorrections[i] * i;
+    }
+    return symbols;
+}
+
+void DecoderStats::writeJson(std::ostream& stream) const {
+    stream << "{\"syncWords\":" << mSyncWords << ",\"syncLosses\":" << mSyncLosses << ",\"framesTried\":" << mFramesTried << ",\"framesPassed\":" << mFramesPassed << ",\"rsFailures\":" << mRsFailures;
+
+    stream << ",\"rsCorrections\":[";
+    for(size_t i = 0; i < mRsCorrections.size(); i++) {
+        stream << (i > 0 ? "," : "") << mRsCorrections[i];
+    }
+
+    stream << "],\"phaseShifts\":[";
+    for(size_t i = 0; i < mPhaseShifts.size(); i++) {
+        stream << (i > 0 ? "," : "") << mPhaseShifts[i];
+    }
+
+    stream << "],\"apids\":{";
+    bool first = true;
+    for(int apid = 0; apid < APID_COUNT; apid++) {
+        if(mPackets[apid] == 0) {
+            continue;
+        }
+        stream << (first ? "" : ",") << "\"" << apid << "\":{\"packets\":" << mPackets[apid] << ",\"mcus\":" << mMcus[apid] << "}";
+        first = false;
+    }
+    stream << "}}";
+}
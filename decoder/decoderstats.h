@@ -0,0 +1,91 @@
+#ifndef DECODERSTATS_H
+#define DECODERSTATS_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <ostream>
+
+// Counters of the frame and packet layers, they are updated on the thread which consumes the frames in stream order
+class DecoderStats {
+  public:
+    static constexpr int APID_COUNT = 2048;
+    static constexpr int RS_MAX_CORRECTIONS = 16;
+    static constexpr int PHASE_SHIFTS = 16;
+
+  public:
+    DecoderStats();
+
+    void reset();
+
+    void syncWordFound() {
+        mSyncWords++;
+    }
+    void syncLost() {
+        mSyncLosses++;
+    }
+
+    // rsResults holds the corrected symbols of the interleaved codewords, -1 when a codeword is uncorrectable
+    void frame(const int* rsResults, int codewords, uint16_t phaseShift, bool passed) {
+        mFramesTried++;
+        mFramesPassed += passed;
+        mPhaseShifts[std::min<int>(phaseShift, PHASE_SHIFTS - 1)]++;
+
+        for(int i = 0; i < codewords; i++) {
+            if(rsResults[i] < 0) {
+                mRsFailures++;
+            } else {
+                mRsCorrections[std::min(rsResults[i], RS_MAX_CORRECTIONS)]++;
+            }
+        }
+    }
+
+    void packet(int apid) {
+        mPackets[apid & (APID_COUNT - 1)]++;
+    }
+    void mcus(int apid, int count) {
+        mMcus[apid & (APID_COUNT - 1)] += count;
+    }
+
+    uint64_t getSyncWords() const {
+        return mSyncWords;
+    }
+    uint64_t getSyncLosses() const {
+        return mSyncLosses;
+    }
+    uint64_t getFramesTried() const {
+        return mFramesTried;
+    }
+    uint64_t getFramesPassed() const {
+        return mFramesPassed;
+    }
+    uint64_t getRsFailures() const {
+        return mRsFailures;
+    }
+    uint64_t getPackets(int apid) const {
+        return mPackets[apid & (APID_COUNT - 1)];
+    }
+    uint64_t getMcus(int apid) const {
+        return mMcus[apid & (APID_COUNT - 1)];
+    }
+
+    // Symbols corrected over all codewords
+    uint64_t getRsCorrectedSymbols() const;
+
+    // One line JSON object, only APIDs with packets are listed
+    void writeJson(std::ostream& stream) const;
+
+  private:
+    uint64_t mSyncWords;
+    uint64_t mSyncLosses;
+    uint64_t mFramesTried;
+    uint64_t mFramesPassed;
+    uint64_t mRsFailures;
+    std::array<uint64_t, RS_MAX_CORRECTIONS + 1> mRsCorrections;
+    std::array<uint64_t, PHASE_SHIFTS> mPhaseShifts;
+    std::array<uint64_t, APID_COUNT> mPackets;
+    std::array<uint64_t, APID_COUNT> mMcus;
+};
+
+#endif // DECODERSTATS_H
@@ -2,115 +2,262 @@
 
 #include <string.h>
 
-#include <iomanip>
+#include <algorithm>
 #include <iostream>
-#include <vector>
 
 static const int INTER_BRANCHES = 36;
 static const int INTER_DELAY = 2048;
 static const int INTER_BASE_LEN = INTER_BRANCHES * INTER_DELAY;
+static const int INTER_TILE_ROWS = 128;
+static const int INTER_TILE_LEN = INTER_BRANCHES * INTER_TILE_ROWS;
 
-DeInterleaver::DeInterleaver() {}
+// The delay line is causal, its output is ahead of the deinterleaved stream by this much.
+// The stream is offset by half a message, to capture both leading and trailing fuzz
+static const uint64_t INTER_OUTPUT_OFFSET = (INTER_BRANCHES - 1) * INTER_BASE_LEN - (INTER_BRANCHES / 2) * INTER_BASE_LEN - (INTER_BRANCHES - 1) * INTER_DELAY;
 
+// 80k stream: 00100111 36 bits 36 bits 00100111 36 bits 36 bits 00100111 ...
+static const uint32_t SYNC_PERIOD = 80;
+static const uint32_t SYNC_LENGTH = 8;
+static const uint32_t SYNC_DEPTH = 4;
+static const uint32_t SYNC_SEARCH_OFFSETS = 80;
+static const uint32_t SYNC_SEARCH_STEP = SYNC_PERIOD * 3;
+static const uint32_t SYNC_LOOKAHEAD = 128;
 
-bool DeInterleaver::findSync(uint8_t* data, uint64_t len, uint32_t step, uint32_t depth, uint64_t* off, uint8_t* sync) {
-    bool result = false;
-    *off = 0;
-    for(uint64_t i = 0; i < len - step * depth; i++) {
-        *sync = byteAt(&data[i]);
-        result = true;
+// Input needed ahead of the current position before a decision can be made without knowing the stream length
+static const uint64_t SEARCH_WINDOW = SYNC_SEARCH_OFFSETS + SYNC_PERIOD * SYNC_DEPTH + SYNC_LENGTH;
+static const uint64_t LOOKAHEAD_WINDOW = SYNC_LOOKAHEAD * SYNC_PERIOD + SYNC_PERIOD;
 
-        for(uint64_t j = 1; j <= depth; j++) {
-            if(*sync != byteAt(&data[i + j * step])) {
-                result = false;
-                break;
-            }
-        }
+DeInterleaver::DeInterleaver()
+    : mBufferOffset(0)
+    , mStreamLength(0)
+    , mSynced(false)
+    , mSync(0)
+    , mVerbose(true)
+    , mDelayLine(INTER_DELAY * (INTER_BRANCHES - 1) * INTER_BRANCHES / 2, 0)
+    , mBranchStart(INTER_BRANCHES)
+    , mBranchPos(INTER_BRANCHES, 0)
+    , mTile(INTER_TILE_LEN)
+    , mTileLength(0)
+    , mResyncedLength(0)
+    , mSkip(INTER_OUTPUT_OFFSET) {
+    uint32_t start = 0;
+    for(int branch = 0; branch < INTER_BRANCHES; branch++) {
+        mBranchStart[branch] = start;
+        start += (INTER_BRANCHES - 1 - branch) * INTER_DELAY;
+    }
+}
 
-        if(result) {
-            *off = i;
-            break;
-        }
+void DeInterleaver::push(const uint8_t* data, uint64_t len, std::vector<uint8_t>& out) {
+    uint64_t keepPos;
+
+    if(mBuffer.empty()) {
+        keepPos = resyncStream(data, mStreamLength, len, false, out);
+        mBuffer.assign(data + (keepPos - mStreamLength), data + len);
+    } else {
+        mBuffer.insert(mBuffer.end(), data, data + len);
+        keepPos = resyncStream(mBuffer.data(), mBufferOffset, mBuffer.size(), false, out);
+        mBuffer.erase(mBuffer.begin(), mBuffer.begin() + (keepPos - mBufferOffset));
     }
 
-    return result;
+    mBufferOffset = keepPos;
+    mStreamLength += len;
 }
 
-void DeInterleaver::deInterleave(uint8_t* data, uint64_t len, uint64_t* outLen) {
-    std::vector<uint8_t> src(len);
+void DeInterleaver::finish(std::vector<uint8_t>& out) {
+    // Streams this short were never decoded
+    if(mStreamLength >= SYNC_PERIOD * 5) {
+        resyncStream(mBuffer.data(), mBufferOffset, mBuffer.size(), true, out);
+    }
+    mBuffer.clear();
+    mBuffer.shrink_to_fit();
 
-    resyncStream(data, len, outLen);
+    if(mVerbose) {
+        std::cout << std::endl;
+    }
 
-    memcpy(src.data(), data, *outLen);
-    memset(data, 0, *outLen);
+    if(mResyncedLength == 0) {
+        return;
+    }
 
-    deInterleaveBlock(src.data(), data, *outLen);
+    // Push the tail of the stream through the delay line
+    const std::vector<uint8_t> zeros(INTER_BASE_LEN, 0);
+    for(uint64_t flushed = 0; flushed < INTER_OUTPUT_OFFSET;) {
+        const uint64_t len = std::min<uint64_t>(zeros.size(), INTER_OUTPUT_OFFSET - flushed);
+        deInterleaveBlock(zeros.data(), len, out);
+        flushed += len;
+    }
+    deInterleaveTile(out);
 }
 
-void DeInterleaver::deInterleaveBlock(uint8_t* src, uint8_t* dst, uint64_t len) {
-    uint64_t pos;
-    for(uint64_t i = 0; i < len; i++) {
-        pos = i + (INTER_BRANCHES - 1) * INTER_DELAY - (i % INTER_BRANCHES) * INTER_BASE_LEN;
-        // Offset it by half a message, to capture both leading and trailing fuzz
-        pos += (INTER_BRANCHES / 2) * INTER_BASE_LEN;
-        if(pos >= 0 && pos < len) {
-            dst[pos] = src[i];
-        }
+uint64_t DeInterleaver::inputPosition(uint64_t pos) const {
+    // Branch b was sent b base lengths before the last one
+    const uint64_t spreadCenter = static_cast<uint64_t>(INTER_BRANCHES - 1) * INTER_BASE_LEN / 2;
+    const uint64_t resyncedPos = pos + INTER_OUTPUT_OFFSET > spreadCenter ? pos + INTER_OUTPUT_OFFSET - spreadCenter : 0;
+
+    auto run = std::upper_bound(mSyncRuns.begin(), mSyncRuns.end(), resyncedPos, [](uint64_t value, const SyncRun& syncRun) {
+        return value < syncRun.resyncedPos;
+    });
+    if(run == mSyncRuns.begin()) {
+        return 0;
     }
+    --run;
+
+    const uint64_t payloadLength = SYNC_PERIOD - SYNC_LENGTH;
+    const uint64_t runOffset = resyncedPos - run->resyncedPos;
+    return run->inputPos + runOffset / payloadLength * SYNC_PERIOD + SYNC_LENGTH + runOffset % payloadLength;
 }
 
-// 80k stream: 00100111 36 bits 36 bits 00100111 36 bits 36 bits 00100111 ...
-void DeInterleaver::resyncStream(uint8_t* data, uint64_t len, uint64_t* outLen) {
-    std::vector<uint8_t> src(data, data + len);
+// data starts at stream position offset, returns the stream position the next call has to continue from
+uint64_t DeInterleaver::resyncStream(const uint8_t* data, uint64_t offset, uint64_t len, bool lastBlock, std::vector<uint8_t>& out) {
     uint64_t off;
     uint64_t pos = 0;
     bool ok;
-    uint8_t sync;
-    *outLen = 0;
 
-    while(pos < len - 80 * 4) {
-        if(!findSync(&src.data()[pos], 80 * 5, 80, 4, &off, &sync)) {
-            pos += 80 * 3;
-            continue;
-        }
+    packBits(data, len);
 
-        std::cout << std::fixed << std::setprecision(2) << ((float)pos / len) * 100 << "% Found sync at " << pos << "\t\t\t\r" << std::flush;
+    while(true) {
+        if(!mSynced) {
+            if(lastBlock ? pos + SYNC_PERIOD * SYNC_DEPTH >= len : pos + SEARCH_WINDOW > len) {
+                break;
+            }
+
+            if(!findSync(pos, std::min(SEARCH_WINDOW, len - pos), SYNC_PERIOD, SYNC_DEPTH, &off, &mSync)) {
+                pos += SYNC_SEARCH_STEP;
+                continue;
+            }
 
-        pos += off;
+            pos += off;
+            mSynced = true;
+            mSyncRuns.push_back({mResyncedLength, offset + pos});
 
-        while(pos < len - 80) {
-            // Look ahead to prevent it losing sync on weak signal
-            ok = false;
-            for(int i = 0; i < 128; i++) {
-                if(pos + i * 80 < len - 80) {
-                    if(byteAt(&src.data()[pos + i * 80]) == sync) {
-                        ok = true;
-                        break;
-                    }
+            if(mVerbose) {
+                std::cout << "Found sync at " << offset + pos << "\t\t\t\r" << std::flush;
+            }
+        }
+
+        if(lastBlock ? pos + SYNC_PERIOD >= len : pos + LOOKAHEAD_WINDOW > len) {
+            break;
+        }
+
+        // Look ahead to prevent it losing sync on weak signal
+        ok = false;
+        for(uint32_t i = 0; i < SYNC_LOOKAHEAD; i++) {
+            if(pos + i * SYNC_PERIOD + SYNC_PERIOD < len) {
+                if(byteAt(pos + i * SYNC_PERIOD) == mSync) {
+                    ok = true;
+                    break;
                 }
             }
+        }
 
-            if(!ok) {
-                break;
+        if(!ok) {
+            mSynced = false;
+            if(mVerbose) {
+                std::cout << "Sync lost at " << offset + pos << "\t\t\t\r" << std::flush;
             }
+            continue;
+        }
+
+        deInterleaveBlock(&data[pos + SYNC_LENGTH], SYNC_PERIOD - SYNC_LENGTH, out);
+        mResyncedLength += SYNC_PERIOD - SYNC_LENGTH;
+        pos += SYNC_PERIOD;
+    }
+
+    return offset + std::min(pos, len);
+}
+
+void DeInterleaver::packBits(const uint8_t* data, uint64_t len) {
+    // Two spare words, so bitsAt() can read past the end
+    mPackedBits.assign(len / 64 + 2, 0);
+
+    uint64_t i = 0;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+    for(; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, &data[i], sizeof(word));
+
+        // Gathers the MSB of every byte, that is the soft bit >= 128 decision, the first byte has to be the lowest one
+        const uint64_t bits = ((word & 0x8080808080808080ULL) * 0x0002040810204081ULL) >> 56;
+        mPackedBits[i / 64] |= bits << (i % 64);
+    }
+#endif
+    for(; i < len; i++) {
+        mPackedBits[i / 64] |= static_cast<uint64_t>(data[i] >> 7) << (i % 64);
+    }
+}
+
+// Checks 57 offsets per step: a bit is set in mismatch where any of the repeats differs from the first sync byte candidate
+bool DeInterleaver::findSync(uint64_t pos, uint64_t len, uint32_t step, uint32_t depth, uint64_t* off, uint8_t* sync) const {
+    *off = 0;
 
-            memcpy(&data[*outLen], &src.data()[pos + 8], 72);
-            pos += 80;
-            *outLen += 72;
+    if(len < step * depth + SYNC_LENGTH) {
+        return false;
+    }
+
+    const uint64_t offsets = std::min<uint64_t>(SYNC_SEARCH_OFFSETS, len - step * depth - SYNC_LENGTH + 1);
+    for(uint64_t base = 0; base < offsets; base += 64 - SYNC_LENGTH + 1) {
+        const uint64_t first = bitsAt(pos + base);
+        uint64_t mismatch = 0;
+        for(uint32_t j = 1; j <= depth; j++) {
+            mismatch |= first ^ bitsAt(pos + base + j * step);
+        }
+
+        uint64_t candidates = ~mismatch;
+        for(uint32_t k = 1; k < SYNC_LENGTH; k++) {
+            candidates &= ~mismatch >> k;
         }
 
-        std::cout << std::fixed << std::setprecision(2) << ((float)pos / len) * 100 << "% Sync lost at " << pos << "\t\t\t\r" << std::flush;
+        const uint64_t count = std::min<uint64_t>(offsets - base, 64 - SYNC_LENGTH + 1);
+        candidates &= (1ULL << count) - 1;
+
+        if(candidates) {
+            *off = base + lowestBit(candidates);
+            *sync = byteAt(pos + *off);
+            return true;
+        }
     }
 
-    std::cout << std::endl;
+    return false;
 }
 
-uint8_t DeInterleaver::byteAt(uint8_t* data) {
-    uint8_t result = 0;
+void DeInterleaver::deInterleaveBlock(const uint8_t* src, uint64_t len, std::vector<uint8_t>& out) {
+    while(len > 0) {
+        const uint64_t count = std::min<uint64_t>(len, INTER_TILE_LEN - mTileLength);
+        memcpy(&mTile[mTileLength], src, count);
+        mTileLength += count;
+        src += count;
+        len -= count;
+
+        if(mTileLength == INTER_TILE_LEN) {
+            deInterleaveTile(out);
+        }
+    }
+}
+
+// Every branch is swapped with its own ring in one go, so the ring accesses stay sequential and the strided ones stay inside the tile
+void DeInterleaver::deInterleaveTile(std::vector<uint8_t>& out) {
+    const uint32_t rows = mTileLength / INTER_BRANCHES;
+    const uint32_t lastRowLength = mTileLength % INTER_BRANCHES;
+
+    // The last branch is not delayed
+    for(int branch = 0; branch < INTER_BRANCHES - 1; branch++) {
+        uint8_t* ring = &mDelayLine[mBranchStart[branch]];
+        const uint32_t branchLength = (INTER_BRANCHES - 1 - branch) * INTER_DELAY;
+        const uint32_t branchRows = rows + (static_cast<uint32_t>(branch) < lastRowLength ? 1 : 0);
+        uint32_t pos = mBranchPos[branch];
+
+        for(uint32_t row = 0; row < branchRows; row++) {
+            std::swap(mTile[row * INTER_BRANCHES + branch], ring[pos]);
+            if(++pos == branchLength) {
+                pos = 0;
+            }
+        }
 
-    for(int i = 0; i < 8; i++) {
-        result = result | (data[i] < 128 ? 0 : 1) << i;
+        mBranchPos[branch] = pos;
     }
 
-    return result;
+    const uint64_t skip = std::min<uint64_t>(mSkip, mTileLength);
+    mSkip -= skip;
+    out.insert(out.end(), mTile.begin() + skip, mTile.begin() + mTileLength);
+    mTileLength = 0;
 }
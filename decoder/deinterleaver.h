@@ -3,18 +3,85 @@
 
 #include <stdint.h>
 
+#include <vector>
+
+// Streaming deinterleaver for the 80k interleaved mode, memory use is bounded by the convolutional delay line
 class DeInterleaver {
-  private:
+  public:
     DeInterleaver();
 
-  public:
-    static void deInterleave(uint8_t* data, uint64_t len, uint64_t* outLen);
+    // Consumes interleaved soft bits, the deinterleaved soft bits available so far are appended to out
+    void push(const uint8_t* data, uint64_t len, std::vector<uint8_t>& out);
+
+    // Flushes the delay line, the total output is as long as the resynced stream
+    void finish(std::vector<uint8_t>& out);
+
+    // Offset in the interleaved input where the output soft bit at pos was sent, the middle of its spread over the delay line
+    uint64_t inputPosition(uint64_t pos) const;
+
+    // Sync found and lost messages are printed to the console by default
+    void setVerbose(bool verbose) {
+        mVerbose = verbose;
+    }
 
   private:
-    static bool findSync(uint8_t* data, uint64_t len, uint32_t step, uint32_t depth, uint64_t* off, uint8_t* sync);
-    static void deInterleaveBlock(uint8_t* src, uint8_t* dst, uint64_t len);
-    static void resyncStream(uint8_t* data, uint64_t len, uint64_t* outLen);
-    static uint8_t byteAt(uint8_t* data);
+    // The payload after every sync byte of a run is appended to the resynced stream
+    struct SyncRun {
+        uint64_t resyncedPos;
+        uint64_t inputPos;
+    };
+
+  private:
+    uint64_t resyncStream(const uint8_t* data, uint64_t offset, uint64_t len, bool lastBlock, std::vector<uint8_t>& out);
+    void deInterleaveBlock(const uint8_t* src, uint64_t len, std::vector<uint8_t>& out);
+    void deInterleaveTile(std::vector<uint8_t>& out);
+    void packBits(const uint8_t* data, uint64_t len);
+    bool findSync(uint64_t pos, uint64_t len, uint32_t step, uint32_t depth, uint64_t* off, uint8_t* sync) const;
+
+    // The hard decision of 8 soft bits starting at pos, first bit in the LSB
+    uint8_t byteAt(uint64_t pos) const {
+        return static_cast<uint8_t>(bitsAt(pos));
+    }
+
+    uint64_t bitsAt(uint64_t pos) const {
+        const uint64_t w = pos / 64;
+        const int shift = pos % 64;
+        return shift == 0 ? mPackedBits[w] : (mPackedBits[w] >> shift) | (mPackedBits[w + 1] << (64 - shift));
+    }
+
+    static int lowestBit(uint64_t i) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(i);
+#else
+        int result = 0;
+        while(!(i & 1)) {
+            i >>= 1;
+            result++;
+        }
+        return result;
+#endif
+    }
+
+  private:
+    std::vector<uint8_t> mBuffer;
+    // Hard decisions of the block being resynced, one bit per soft bit
+    std::vector<uint64_t> mPackedBits;
+    uint64_t mBufferOffset;
+    uint64_t mStreamLength;
+    bool mSynced;
+    uint8_t mSync;
+    bool mVerbose;
+
+    // One ring per branch, branch b is delayed by (BRANCHES - 1 - b) * DELAY of its own symbols
+    std::vector<uint8_t> mDelayLine;
+    std::vector<uint32_t> mBranchStart;
+    std::vector<uint32_t> mBranchPos;
+    // Rows of one symbol per branch, starting at branch 0, are collected here and deinterleaved in place
+    std::vector<uint8_t> mTile;
+    uint32_t mTileLength;
+    uint64_t mResyncedLength;
+    uint64_t mSkip;
+    std::vector<SyncRun> mSyncRuns;
 };
 
 #endif // DEINTERLEAVER_H
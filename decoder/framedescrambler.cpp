@@ -0,0 +1,168 @@
+#include "framedescrambler.h"
+
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__) && !defined(__SSE2__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+namespace {
+
+const uint8_t PRAND[255] = {
+    0xff, 0x48, 0x0e, 0xc0, 0x9a, 0x0d, 0x70, 0xbc, 0x8e, 0x2c, 0x93, 0xad, 0xa7, 0xb7, 0x46, 0xce, 0x5a,
+    0x97, 0x7d, 0xcc, 0x32, 0xa2, 0xbf, 0x3e, 0x0a, 0x10, 0xf1, 0x88, 0x94, 0xcd, 0xea, 0xb1, 0xfe, 0x90,
+    0x1d, 0x81, 0x34, 0x1a, 0xe1, 0x79, 0x1c, 0x59, 0x27, 0x5b, 0x4f, 0x6e, 0x8d, 0x9c, 0xb5, 0x2e, 0xfb,
+    0x98, 0x65, 0x45, 0x7e, 0x7c, 0x14, 0x21, 0xe3, 0x11, 0x29, 0x9b, 0xd5, 0x63, 0xfd, 0x20, 0x3b, 0x02,
+    0x68, 0x35, 0xc2, 0xf2, 0x38, 0xb2, 0x4e, 0xb6, 0x9e, 0xdd, 0x1b, 0x39, 0x6a, 0x5d, 0xf7, 0x30, 0xca,
+    0x8a, 0xfc, 0xf8, 0x28, 0x43, 0xc6, 0x22, 0x53, 0x37, 0xaa, 0xc7, 0xfa, 0x40, 0x76, 0x04, 0xd0, 0x6b,
+    0x85, 0xe4, 0x71, 0x64, 0x9d, 0x6d, 0x3d, 0xba, 0x36, 0x72, 0xd4, 0xbb, 0xee, 0x61, 0x95, 0x15, 0xf9,
+    0xf0, 0x50, 0x87, 0x8c, 0x44, 0xa6, 0x6f, 0x55, 0x8f, 0xf4, 0x80, 0xec, 0x09, 0xa0, 0xd7, 0x0b, 0xc8,
+    0xe2, 0xc9, 0x3a, 0xda, 0x7b, 0x74, 0x6c, 0xe5, 0xa9, 0x77, 0xdc, 0xc3, 0x2a, 0x2b, 0xf3, 0xe0, 0xa1,
+    0x0f, 0x18, 0x89, 0x4c, 0xde, 0xab, 0x1f, 0xe9, 0x01, 0xd8, 0x13, 0x41, 0xae, 0x17, 0x91, 0xc5, 0x92,
+    0x75, 0xb4, 0xf6, 0xe8, 0xd9, 0xcb, 0x52, 0xef, 0xb9, 0x86, 0x54, 0x57, 0xe7, 0xc1, 0x42, 0x1e, 0x31,
+    0x12, 0x99, 0xbd, 0x56, 0x3f, 0xd2, 0x03, 0xb0, 0x26, 0x83, 0x5c, 0x2f, 0x23, 0x8b, 0x24, 0xeb, 0x69,
+    0xed, 0xd1, 0xb3, 0x96, 0xa5, 0xdf, 0x73, 0x0c, 0xa8, 0xaf, 0xcf, 0x82, 0x84, 0x3c, 0x62, 0x25, 0x33,
+    0x7a, 0xac, 0x7f, 0xa4, 0x07, 0x60, 0x4d, 0x06, 0xb8, 0x5e, 0x47, 0x16, 0x49, 0xd6, 0xd3, 0xdb, 0xa3,
+    0x67, 0x2d, 0x4b, 0xbe, 0xe6, 0x19, 0x51, 0x5f, 0x9f, 0x05, 0x08, 0x78, 0xc4, 0x4a, 0x66, 0xf5, 0x58
+};
+
+// PRAND repeated over the whole frame, the sync word is not randomized
+struct Sequence {
+    Sequence() {
+        memset(bytes, 0, FrameDescrambler::SYNC_LENGTH);
+        for(int i = FrameDescrambler::SYNC_LENGTH; i < FrameDescrambler::FRAME_LENGTH; i++) {
+            bytes[i] = PRAND[(i - FrameDescrambler::SYNC_LENGTH) % 255];
+        }
+    }
+
+    alignas(16) uint8_t bytes[FrameDescrambler::FRAME_LENGTH];
+};
+
+const Sequence sSequence;
+
+inline uint8_t differentialDecodeByte(const uint8_t* frame, int i) {
+    const uint8_t lastBit = i > 0 ? frame[i - 1] & 1 : 0;
+    return frame[i] ^ (((frame[i] >> 1) & 0x7F) | (lastBit << 7));
+}
+
+} // namespace
+
+FrameDescrambler::FrameDescrambler(bool differentialDecode)
+    : mDifferentialDecode(differentialDecode)
+    , mKernel(kernelScalar) {
+#if defined(CPU_FEATURES_X86)
+    if(CpuFeatures::hasSSE2()) {
+        mKernel = kernelSSE2;
+    }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+    mKernel = kernelNEON;
+#endif
+}
+
+uint32_t FrameDescrambler::process(uint8_t* frame) const {
+    // The sync word and the polarity byte are decoded ahead, so the kernel can apply everything in a single sweep
+    uint8_t sync[SYNC_LENGTH];
+    for(int i = 0; i < SYNC_LENGTH; i++) {
+        sync[i] = mDifferentialDecode ? differentialDecodeByte(frame, i) : frame[i];
+    }
+
+    const uint8_t polarity = (mDifferentialDecode ? differentialDecodeByte(frame, 9) : frame[9]) ^ sSequence.bytes[9];
+    const uint8_t invert = polarity == 0xFF ? 0xFF : 0x00;
+
+    mKernel(frame, invert, mDifferentialDecode);
+
+    uint32_t syncWord;
+    memcpy(&syncWord, sync, sizeof(syncWord));
+    return syncWord;
+}
+
+// The kernels run backwards, so the last bit of the previous byte is still the undecoded one when it is needed
+
+void FrameDescrambler::kernelScalar(uint8_t* frame, uint8_t invert, bool differentialDecode) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // The word-wide shift below needs the bytes in little endian order
+    for(int i = FRAME_LENGTH - 1; i >= 0; i--) {
+        const uint8_t decoded = differentialDecode ? differentialDecodeByte(frame, i) : frame[i];
+        frame[i] = decoded ^ sSequence.bytes[i] ^ invert;
+    }
+#else
+    const uint64_t differentialMask = differentialDecode ? ~0ULL : 0ULL;
+    const uint64_t invertMask = 0x0101010101010101ULL * invert;
+
+    for(int i = FRAME_LENGTH - 8; i >= 0; i -= 8) {
+        uint64_t word;
+        uint64_t sequence;
+        memcpy(&word, &frame[i], sizeof(word));
+        memcpy(&sequence, &sSequence.bytes[i], sizeof(sequence));
+
+        // Little endian, so the byte before each one is found 8 bits lower in the word
+        const uint64_t lastBit = i > 0 ? frame[i - 1] & 1 : 0;
+        const uint64_t mask = ((word >> 1) & 0x7F7F7F7F7F7F7F7FULL) | ((word << 15) & 0x8080808080808080ULL) | (lastBit << 7);
+
+        word ^= (mask & differentialMask) ^ sequence ^ invertMask;
+        memcpy(&frame[i], &word, sizeof(word));
+    }
+#endif
+}
+
+#if defined(CPU_FEATURES_X86)
+
+TARGET_SSE2 void FrameDescrambler::kernelSSE2(uint8_t* frame, uint8_t invert, bool differentialDecode) {
+    const __m128i differentialMask = _mm_set1_epi8(differentialDecode ? -1 : 0);
+    const __m128i invertMask = _mm_set1_epi8(static_cast<char>(invert));
+    const __m128i lowBits = _mm_set1_epi8(0x7F);
+    const __m128i highBit = _mm_set1_epi8(static_cast<char>(0x80));
+
+    for(int i = FRAME_LENGTH - 16; i >= 0; i -= 16) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&frame[i]));
+        const __m128i previous = i > 0 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(&frame[i - 1])) : _mm_slli_si128(data, 1);
+        const __m128i mask = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(data, 1), lowBits), _mm_and_si128(_mm_slli_epi16(previous, 7), highBit));
+        const __m128i sequence = _mm_load_si128(reinterpret_cast<const __m128i*>(&sSequence.bytes[i]));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&frame[i]), _mm_xor_si128(_mm_xor_si128(data, _mm_and_si128(mask, differentialMask)), _mm_xor_si128(sequence, invertMask)));
+    }
+}
+
+#else
+
+void FrameDescrambler::kernelSSE2(uint8_t* frame, uint8_t invert, bool differentialDecode) {
+    kernelScalar(frame, invert, differentialDecode);
+}
+
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+
+void FrameDescrambler::kernelNEON(uint8_t* frame, uint8_t invert, bool differentialDecode) {
+    const uint8x16_t differentialMask = vdupq_n_u8(differentialDecode ? 0xFF : 0x00);
+    const uint8x16_t invertMask = vdupq_n_u8(invert);
+
+    for(int i = FRAME_LENGTH - 16; i >= 0; i -= 16) {
+        const uint8x16_t data = vld1q_u8(&frame[i]);
+        const uint8x16_t previous = i > 0 ? vld1q_u8(&frame[i - 1]) : vextq_u8(vdupq_n_u8(0), data, 15);
+        const uint8x16_t mask = vorrq_u8(vshrq_n_u8(data, 1), vshlq_n_u8(previous, 7));
+        const uint8x16_t sequence = vld1q_u8(&sSequence.bytes[i]);
+
+        vst1q_u8(&frame[i], veorq_u8(veorq_u8(data, vandq_u8(mask, differentialMask)), veorq_u8(sequence, invertMask)));
+    }
+}
+
+#else
+
+void FrameDescrambler::kernelNEON(uint8_t* frame, uint8_t invert, bool differentialDecode) {
+    kernelScalar(frame, invert, differentialDecode);
+}
+
+#endif
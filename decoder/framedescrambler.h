@@ -0,0 +1,31 @@
+#ifndef FRAMEDESCRAMBLER_H
+#define FRAMEDESCRAMBLER_H
+
+#include <stdint.h>
+
+// Post Viterbi processing of a CADU: optional differential decoding, PRAND removal and polarity correction in one pass
+class FrameDescrambler {
+  public:
+    static constexpr int FRAME_LENGTH = 1024;
+    static constexpr int SYNC_LENGTH = 4;
+
+  public:
+    FrameDescrambler(bool differentialDecode);
+
+    // Works in place on FRAME_LENGTH bytes, afterwards the codewords follow the sync word in the interleaved Reed-Solomon layout.
+    // Returns the sync word as decoded, before the polarity correction.
+    uint32_t process(uint8_t* frame) const;
+
+  private:
+    typedef void (*KernelFunction)(uint8_t* frame, uint8_t invert, bool differentialDecode);
+
+    static void kernelScalar(uint8_t* frame, uint8_t invert, bool differentialDecode);
+    static void kernelSSE2(uint8_t* frame, uint8_t invert, bool differentialDecode);
+    static void kernelNEON(uint8_t* frame, uint8_t invert, bool differentialDecode);
+
+  private:
+    bool mDifferentialDecode;
+    KernelFunction mKernel;
+};
+
+#endif // FRAMEDESCRAMBLER_H
@@ -0,0 +1,52 @@
+#include "framejournal.h"
+
+#include <array>
+
+#include "packetparser.h"
+
+bool FrameJournal::open(const std::string& path) {
+    mStream.open(path, std::ios::binary | std::ios::trunc);
+    if(!mStream.is_open()) {
+        return false;
+    }
+
+    Header header;
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.frameLength = FRAME_LENGTH;
+    mStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    return true;
+}
+
+void FrameJournal::close() {
+    if(mStream.is_open()) {
+        mStream.close();
+    }
+}
+
+void FrameJournal::write(const uint8_t* frame) {
+    mStream.write(reinterpret_cast<const char*>(frame), FRAME_LENGTH);
+}
+
+size_t FrameJournal::replay(const std::string& path, PacketParser& packetParser) {
+    std::ifstream stream(path, std::ios::binary);
+    if(!stream.is_open()) {
+        return 0;
+    }
+
+    Header header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(stream.gcount() != sizeof(header) || header.magic != MAGIC || header.version != VERSION || header.frameLength != FRAME_LENGTH) {
+        return 0;
+    }
+
+    std::array<uint8_t, FRAME_LENGTH> frame;
+    size_t frames = 0;
+    while(stream.read(reinterpret_cast<char*>(frame.data()), frame.size())) {
+        packetParser.parseFrame(frame.data(), FRAME_LENGTH);
+        frames++;
+    }
+
+    return frames;
+}
@@ -0,0 +1,48 @@
+#ifndef FRAMEJOURNAL_H
+#define FRAMEJOURNAL_H
+
+#include <stdint.h>
+
+#include <fstream>
+#include <string>
+
+class PacketParser;
+
+// Binary journal of the RS corrected VCDUs, replaying it rebuilds the images without demodulation, Viterbi and RS decoding
+class FrameJournal {
+  public:
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const {
+        return mStream.is_open();
+    }
+
+    void write(const uint8_t* frame);
+
+    // Feeds every journaled frame to the parser, returns the number of frames
+    static size_t replay(const std::string& path, PacketParser& packetParser);
+
+    static std::string pathFor(const std::string& inputPath) {
+        return inputPath.substr(0, inputPath.find_last_of(".") + 1) + "frames";
+    }
+
+  public:
+    static constexpr int FRAME_LENGTH = 892;
+
+  private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t frameLength;
+    };
+
+  private:
+    std::ofstream mStream;
+
+  private:
+    static constexpr uint32_t MAGIC = 0x4D52464D; // "MFRM"
+    static constexpr uint32_t VERSION = 1;
+};
+
+#endif // FRAMEJOURNAL_H
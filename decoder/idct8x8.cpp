@@ -0,0 +1,424 @@
+#include "idct8x8.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__) && !defined(__SSE2__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+// The 16 bit version keeps the coefficients scaled by 2^INT16_PASS_BITS through both passes, additions saturate.
+// The AAN multipliers are 1 or 2 times (1 +- a Q16 fraction), the fraction is a (x * c) >> 16 high multiply (pmulhw).
+// All fractions are even, NEON computes them with vqdmulh and c / 2, bit exact with the other kernels.
+
+namespace {
+
+constexpr int INT16_PASS_BITS = 2;
+constexpr int INT16_DESCALE_BITS = INT16_PASS_BITS + 3;
+constexpr int16_t INT16_BIAS = (1 << (INT16_DESCALE_BITS - 1)) + (128 << INT16_DESCALE_BITS);
+
+constexpr int16_t FIX_0_414213562 = 27146; // 1.414213562 = 1 + 0.414213562
+constexpr int16_t FIX_0_076120467 = 4988;  // 1.847759065 = 2 * (1 - 0.076120467)
+constexpr int16_t FIX_0_082392200 = 5400;  // 1.082392200 = 1 + 0.082392200
+constexpr int16_t FIX_0_306562965 = 20092; // 2.613125930 = 2 * (1 + 0.306562965)
+
+const double AAN_SCALE[8] = {1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379};
+
+inline void aanFloat(const float* in, int inStride, float* out, int outStride) {
+    float tmp0 = in[0 * inStride];
+    float tmp1 = in[2 * inStride];
+    float tmp2 = in[4 * inStride];
+    float tmp3 = in[6 * inStride];
+
+    float tmp10 = tmp0 + tmp2;
+    float tmp11 = tmp0 - tmp2;
+    float tmp13 = tmp1 + tmp3;
+    float tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    float tmp4 = in[1 * inStride];
+    float tmp5 = in[3 * inStride];
+    float tmp6 = in[5 * inStride];
+    float tmp7 = in[7 * inStride];
+
+    float z13 = tmp6 + tmp5;
+    float z10 = tmp6 - tmp5;
+    float z11 = tmp4 + tmp7;
+    float z12 = tmp4 - tmp7;
+
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562f;
+
+    float z5 = (z10 + z12) * 1.847759065f;
+    tmp10 = z5 - z12 * 1.082392200f;
+    tmp12 = z5 - z10 * 2.613125930f;
+
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 - tmp5;
+
+    out[0 * outStride] = tmp0 + tmp7;
+    out[7 * outStride] = tmp0 - tmp7;
+    out[1 * outStride] = tmp1 + tmp6;
+    out[6 * outStride] = tmp1 - tmp6;
+    out[2 * outStride] = tmp2 + tmp5;
+    out[5 * outStride] = tmp2 - tmp5;
+    out[3 * outStride] = tmp3 + tmp4;
+    out[4 * outStride] = tmp3 - tmp4;
+}
+
+inline int16_t add16(int a, int b) {
+    return static_cast<int16_t>(std::clamp(a + b, INT16_MIN, INT16_MAX));
+}
+
+inline int16_t sub16(int a, int b) {
+    return static_cast<int16_t>(std::clamp(a - b, INT16_MIN, INT16_MAX));
+}
+
+inline int16_t mulhi16(int16_t a, int16_t b) {
+    return static_cast<int16_t>((a * b) >> 16);
+}
+
+inline void aanInt16(int16_t* v, int stride) {
+    int16_t tmp10 = add16(v[0 * stride], v[4 * stride]);
+    int16_t tmp11 = sub16(v[0 * stride], v[4 * stride]);
+    int16_t tmp13 = add16(v[2 * stride], v[6 * stride]);
+    int16_t diff = sub16(v[2 * stride], v[6 * stride]);
+    int16_t tmp12 = sub16(add16(diff, mulhi16(diff, FIX_0_414213562)), tmp13);
+
+    int16_t tmp0 = add16(tmp10, tmp13);
+    int16_t tmp3 = sub16(tmp10, tmp13);
+    int16_t tmp1 = add16(tmp11, tmp12);
+    int16_t tmp2 = sub16(tmp11, tmp12);
+
+    int16_t z13 = add16(v[5 * stride], v[3 * stride]);
+    int16_t z10 = sub16(v[5 * stride], v[3 * stride]);
+    int16_t z11 = add16(v[1 * stride], v[7 * stride]);
+    int16_t z12 = sub16(v[1 * stride], v[7 * stride]);
+
+    int16_t tmp7 = add16(z11, z13);
+    diff = sub16(z11, z13);
+    tmp11 = add16(diff, mulhi16(diff, FIX_0_414213562));
+
+    int16_t sum = add16(z10, z12);
+    int16_t z5 = sub16(sum, mulhi16(sum, FIX_0_076120467));
+    z5 = add16(z5, z5);
+    tmp10 = sub16(z5, add16(z12, mulhi16(z12, FIX_0_082392200)));
+    int16_t z10x = add16(z10, mulhi16(z10, FIX_0_306562965));
+    tmp12 = sub16(z5, add16(z10x, z10x));
+
+    int16_t tmp6 = sub16(tmp12, tmp7);
+    int16_t tmp5 = sub16(tmp11, tmp6);
+    int16_t tmp4 = sub16(tmp10, tmp5);
+
+    v[0 * stride] = add16(tmp0, tmp7);
+    v[7 * stride] = sub16(tmp0, tmp7);
+    v[1 * stride] = add16(tmp1, tmp6);
+    v[6 * stride] = sub16(tmp1, tmp6);
+    v[2 * stride] = add16(tmp2, tmp5);
+    v[5 * stride] = sub16(tmp2, tmp5);
+    v[3 * stride] = add16(tmp3, tmp4);
+    v[4 * stride] = sub16(tmp3, tmp4);
+}
+
+} // namespace
+
+const Idct8x8::Kernels Idct8x8::sKernels;
+
+Idct8x8::Kernels::Kernels()
+    : idctInt16(idctInt16Scalar) {
+#if defined(CPU_FEATURES_X86)
+    if(CpuFeatures::hasSSE2()) {
+        idctInt16 = idctInt16SSE2;
+    }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+    idctInt16 = idctInt16NEON;
+#endif
+}
+
+void Idct8x8::scaleFloat(const std::array<int, 64>& dqt, std::array<float, 64>& scaled) {
+    // The final division by 8 of the two passes is folded in too
+    for(int i = 0; i < 64; i++) {
+        scaled[i] = static_cast<float>(dqt[i] * AAN_SCALE[i / 8] * AAN_SCALE[i % 8] / 8.0);
+    }
+}
+
+void Idct8x8::scaleInt16(const std::array<int, 64>& dqt, std::array<int32_t, 64>& scaled) {
+    for(int i = 0; i < 64; i++) {
+        scaled[i] = static_cast<int32_t>(std::lround(dqt[i] * AAN_SCALE[i / 8] * AAN_SCALE[i % 8] * (1 << (INT16_PASS_BITS + INT16_TABLE_BITS))));
+    }
+}
+
+void Idct8x8::idctFloat(const float* coefficients, uint8_t* pixels) {
+    float workspace[64];
+
+    for(int x = 0; x < 8; x++) {
+        const float* in = &coefficients[x];
+        float* out = &workspace[x];
+
+        // Columns without AC coefficients are common, their output is constant
+        if(in[8] == 0 && in[16] == 0 && in[24] == 0 && in[32] == 0 && in[40] == 0 && in[48] == 0 && in[56] == 0) {
+            for(int y = 0; y < 8; y++) {
+                out[y * 8] = in[0];
+            }
+            continue;
+        }
+
+        aanFloat(in, 8, out, 8);
+    }
+
+    float row[8];
+    for(int y = 0; y < 8; y++) {
+        aanFloat(&workspace[y * 8], 1, row, 1);
+
+        for(int x = 0; x < 8; x++) {
+            // Truncating v + 128.5 rounds, negative values are clamped to 0 anyway
+            int value = static_cast<int>(row[x] + 128.5f);
+            pixels[y * 8 + x] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+        }
+    }
+}
+
+void Idct8x8::idctInt16Scalar(const int16_t* coefficients, uint8_t* pixels) {
+    int16_t workspace[64];
+    std::copy(coefficients, coefficients + 64, workspace);
+
+    for(int x = 0; x < 8; x++) {
+        aanInt16(&workspace[x], 8);
+    }
+    for(int y = 0; y < 8; y++) {
+        aanInt16(&workspace[y * 8], 1);
+    }
+
+    for(int i = 0; i < 64; i++) {
+        int value = std::clamp(workspace[i] + INT16_BIAS, INT16_MIN, INT16_MAX) >> INT16_DESCALE_BITS;
+        pixels[i] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+}
+
+#if defined(CPU_FEATURES_X86)
+
+namespace {
+
+TARGET_SSE2 inline void aanSSE2(__m128i* v) {
+    const __m128i fix0414 = _mm_set1_epi16(FIX_0_414213562);
+    const __m128i fix0076 = _mm_set1_epi16(FIX_0_076120467);
+    const __m128i fix0082 = _mm_set1_epi16(FIX_0_082392200);
+    const __m128i fix0306 = _mm_set1_epi16(FIX_0_306562965);
+
+    __m128i tmp10 = _mm_adds_epi16(v[0], v[4]);
+    __m128i tmp11 = _mm_subs_epi16(v[0], v[4]);
+    __m128i tmp13 = _mm_adds_epi16(v[2], v[6]);
+    __m128i diff = _mm_subs_epi16(v[2], v[6]);
+    __m128i tmp12 = _mm_subs_epi16(_mm_adds_epi16(diff, _mm_mulhi_epi16(diff, fix0414)), tmp13);
+
+    __m128i tmp0 = _mm_adds_epi16(tmp10, tmp13);
+    __m128i tmp3 = _mm_subs_epi16(tmp10, tmp13);
+    __m128i tmp1 = _mm_adds_epi16(tmp11, tmp12);
+    __m128i tmp2 = _mm_subs_epi16(tmp11, tmp12);
+
+    __m128i z13 = _mm_adds_epi16(v[5], v[3]);
+    __m128i z10 = _mm_subs_epi16(v[5], v[3]);
+    __m128i z11 = _mm_adds_epi16(v[1], v[7]);
+    __m128i z12 = _mm_subs_epi16(v[1], v[7]);
+
+    __m128i tmp7 = _mm_adds_epi16(z11, z13);
+    diff = _mm_subs_epi16(z11, z13);
+    tmp11 = _mm_adds_epi16(diff, _mm_mulhi_epi16(diff, fix0414));
+
+    __m128i sum = _mm_adds_epi16(z10, z12);
+    __m128i z5 = _mm_subs_epi16(sum, _mm_mulhi_epi16(sum, fix0076));
+    z5 = _mm_adds_epi16(z5, z5);
+    tmp10 = _mm_subs_epi16(z5, _mm_adds_epi16(z12, _mm_mulhi_epi16(z12, fix0082)));
+    __m128i z10x = _mm_adds_epi16(z10, _mm_mulhi_epi16(z10, fix0306));
+    tmp12 = _mm_subs_epi16(z5, _mm_adds_epi16(z10x, z10x));
+
+    __m128i tmp6 = _mm_subs_epi16(tmp12, tmp7);
+    __m128i tmp5 = _mm_subs_epi16(tmp11, tmp6);
+    __m128i tmp4 = _mm_subs_epi16(tmp10, tmp5);
+
+    v[0] = _mm_adds_epi16(tmp0, tmp7);
+    v[7] = _mm_subs_epi16(tmp0, tmp7);
+    v[1] = _mm_adds_epi16(tmp1, tmp6);
+    v[6] = _mm_subs_epi16(tmp1, tmp6);
+    v[2] = _mm_adds_epi16(tmp2, tmp5);
+    v[5] = _mm_subs_epi16(tmp2, tmp5);
+    v[3] = _mm_adds_epi16(tmp3, tmp4);
+    v[4] = _mm_subs_epi16(tmp3, tmp4);
+}
+
+TARGET_SSE2 inline void transposeSSE2(__m128i* v) {
+    __m128i a0 = _mm_unpacklo_epi16(v[0], v[1]);
+    __m128i a1 = _mm_unpackhi_epi16(v[0], v[1]);
+    __m128i a2 = _mm_unpacklo_epi16(v[2], v[3]);
+    __m128i a3 = _mm_unpackhi_epi16(v[2], v[3]);
+    __m128i a4 = _mm_unpacklo_epi16(v[4], v[5]);
+    __m128i a5 = _mm_unpackhi_epi16(v[4], v[5]);
+    __m128i a6 = _mm_unpacklo_epi16(v[6], v[7]);
+    __m128i a7 = _mm_unpackhi_epi16(v[6], v[7]);
+
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+    v[0] = _mm_unpacklo_epi64(b0, b4);
+    v[1] = _mm_unpackhi_epi64(b0, b4);
+    v[2] = _mm_unpacklo_epi64(b1, b5);
+    v[3] = _mm_unpackhi_epi64(b1, b5);
+    v[4] = _mm_unpacklo_epi64(b2, b6);
+    v[5] = _mm_unpackhi_epi64(b2, b6);
+    v[6] = _mm_unpacklo_epi64(b3, b7);
+    v[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+} // namespace
+
+TARGET_SSE2 void Idct8x8::idctInt16SSE2(const int16_t* coefficients, uint8_t* pixels) {
+    __m128i v[8];
+    for(int y = 0; y < 8; y++) {
+        v[y] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&coefficients[y * 8]));
+    }
+
+    // Every register holds a row, the first pass transforms the columns
+    aanSSE2(v);
+    transposeSSE2(v);
+    aanSSE2(v);
+    transposeSSE2(v);
+
+    const __m128i bias = _mm_set1_epi16(INT16_BIAS);
+    for(int y = 0; y < 8; y += 2) {
+        __m128i row0 = _mm_srai_epi16(_mm_adds_epi16(v[y], bias), INT16_DESCALE_BITS);
+        __m128i row1 = _mm_srai_epi16(_mm_adds_epi16(v[y + 1], bias), INT16_DESCALE_BITS);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&pixels[y * 8]), _mm_packus_epi16(row0, row1));
+    }
+}
+
+#else
+
+void Idct8x8::idctInt16SSE2(const int16_t* coefficients, uint8_t* pixels) {
+    idctInt16Scalar(coefficients, pixels);
+}
+
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+
+namespace {
+
+inline void aanNEON(int16x8_t* v) {
+    // vqdmulh is (2 * a * b) >> 16, with half of the even fractions it is the same as pmulhw
+    const int16x8_t fix0414 = vdupq_n_s16(FIX_0_414213562 / 2);
+    const int16x8_t fix0076 = vdupq_n_s16(FIX_0_076120467 / 2);
+    const int16x8_t fix0082 = vdupq_n_s16(FIX_0_082392200 / 2);
+    const int16x8_t fix0306 = vdupq_n_s16(FIX_0_306562965 / 2);
+
+    int16x8_t tmp10 = vqaddq_s16(v[0], v[4]);
+    int16x8_t tmp11 = vqsubq_s16(v[0], v[4]);
+    int16x8_t tmp13 = vqaddq_s16(v[2], v[6]);
+    int16x8_t diff = vqsubq_s16(v[2], v[6]);
+    int16x8_t tmp12 = vqsubq_s16(vqaddq_s16(diff, vqdmulhq_s16(diff, fix0414)), tmp13);
+
+    int16x8_t tmp0 = vqaddq_s16(tmp10, tmp13);
+    int16x8_t tmp3 = vqsubq_s16(tmp10, tmp13);
+    int16x8_t tmp1 = vqaddq_s16(tmp11, tmp12);
+    int16x8_t tmp2 = vqsubq_s16(tmp11, tmp12);
+
+    int16x8_t z13 = vqaddq_s16(v[5], v[3]);
+    int16x8_t z10 = vqsubq_s16(v[5], v[3]);
+    int16x8_t z11 = vqaddq_s16(v[1], v[7]);
+    int16x8_t z12 = vqsubq_s16(v[1], v[7]);
+
+    int16x8_t tmp7 = vqaddq_s16(z11, z13);
+    diff = vqsubq_s16(z11, z13);
+    tmp11 = vqaddq_s16(diff, vqdmulhq_s16(diff, fix0414));
+
+    int16x8_t sum = vqaddq_s16(z10, z12);
+    int16x8_t z5 = vqsubq_s16(sum, vqdmulhq_s16(sum, fix0076));
+    z5 = vqaddq_s16(z5, z5);
+    tmp10 = vqsubq_s16(z5, vqaddq_s16(z12, vqdmulhq_s16(z12, fix0082)));
+    int16x8_t z10x = vqaddq_s16(z10, vqdmulhq_s16(z10, fix0306));
+    tmp12 = vqsubq_s16(z5, vqaddq_s16(z10x, z10x));
+
+    int16x8_t tmp6 = vqsubq_s16(tmp12, tmp7);
+    int16x8_t tmp5 = vqsubq_s16(tmp11, tmp6);
+    int16x8_t tmp4 = vqsubq_s16(tmp10, tmp5);
+
+    v[0] = vqaddq_s16(tmp0, tmp7);
+    v[7] = vqsubq_s16(tmp0, tmp7);
+    v[1] = vqaddq_s16(tmp1, tmp6);
+    v[6] = vqsubq_s16(tmp1, tmp6);
+    v[2] = vqaddq_s16(tmp2, tmp5);
+    v[5] = vqsubq_s16(tmp2, tmp5);
+    v[3] = vqaddq_s16(tmp3, tmp4);
+    v[4] = vqsubq_s16(tmp3, tmp4);
+}
+
+inline void transposeNEON(int16x8_t* v) {
+    int16x8x2_t t0 = vtrnq_s16(v[0], v[1]);
+    int16x8x2_t t1 = vtrnq_s16(v[2], v[3]);
+    int16x8x2_t t2 = vtrnq_s16(v[4], v[5]);
+    int16x8x2_t t3 = vtrnq_s16(v[6], v[7]);
+
+    // Columns 0 and 4, 2 and 6 from the even lanes, 1 and 5, 3 and 7 from the odd ones
+    int32x4x2_t u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]), vreinterpretq_s32_s16(t1.val[0]));
+    int32x4x2_t u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]), vreinterpretq_s32_s16(t1.val[1]));
+    int32x4x2_t u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]), vreinterpretq_s32_s16(t3.val[0]));
+    int32x4x2_t u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]), vreinterpretq_s32_s16(t3.val[1]));
+
+    v[0] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u0.val[0])), vget_low_s16(vreinterpretq_s16_s32(u2.val[0])));
+    v[4] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u0.val[0])), vget_high_s16(vreinterpretq_s16_s32(u2.val[0])));
+    v[2] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u0.val[1])), vget_low_s16(vreinterpretq_s16_s32(u2.val[1])));
+    v[6] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u0.val[1])), vget_high_s16(vreinterpretq_s16_s32(u2.val[1])));
+    v[1] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u1.val[0])), vget_low_s16(vreinterpretq_s16_s32(u3.val[0])));
+    v[5] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u1.val[0])), vget_high_s16(vreinterpretq_s16_s32(u3.val[0])));
+    v[3] = vcombine_s16(vget_low_s16(vreinterpretq_s16_s32(u1.val[1])), vget_low_s16(vreinterpretq_s16_s32(u3.val[1])));
+    v[7] = vcombine_s16(vget_high_s16(vreinterpretq_s16_s32(u1.val[1])), vget_high_s16(vreinterpretq_s16_s32(u3.val[1])));
+}
+
+} // namespace
+
+void Idct8x8::idctInt16NEON(const int16_t* coefficients, uint8_t* pixels) {
+    int16x8_t v[8];
+    for(int y = 0; y < 8; y++) {
+        v[y] = vld1q_s16(&coefficients[y * 8]);
+    }
+
+    aanNEON(v);
+    transposeNEON(v);
+    aanNEON(v);
+    transposeNEON(v);
+
+    const int16x8_t bias = vdupq_n_s16(INT16_BIAS);
+    for(int y = 0; y < 8; y++) {
+        vst1_u8(&pixels[y * 8], vqmovun_s16(vshrq_n_s16(vqaddq_s16(v[y], bias), INT16_DESCALE_BITS)));
+    }
+}
+
+#else
+
+void Idct8x8::idctInt16NEON(const int16_t* coefficients, uint8_t* pixels) {
+    idctInt16Scalar(coefficients, pixels);
+}
+
+#endif
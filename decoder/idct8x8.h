@@ -0,0 +1,44 @@
+#ifndef IDCT8X8_H
+#define IDCT8X8_H
+
+#include <stdint.h>
+
+#include <array>
+
+// Separable AAN 8x8 inverse DCT.
+// The coefficients are in natural order and already multiplied by the table from scaleFloat() or scaleInt16(), which folds the
+// dequantization and the AAN scale factors together. The results are level shifted and clamped to 8 bit pixels.
+class Idct8x8 {
+  public:
+    static void scaleFloat(const std::array<int, 64>& dqt, std::array<float, 64>& scaled);
+    // Scaled by 2^INT16_TABLE_BITS, (coefficient * scaled) >> INT16_TABLE_BITS is the input of idctInt16()
+    static void scaleInt16(const std::array<int, 64>& dqt, std::array<int32_t, 64>& scaled);
+
+    static void idctFloat(const float* coefficients, uint8_t* pixels);
+
+    // 16 bit fixed point, faster but less accurate than the float version, out of range coefficients saturate
+    static void idctInt16(const int16_t* coefficients, uint8_t* pixels) {
+        sKernels.idctInt16(coefficients, pixels);
+    }
+
+  public:
+    static constexpr int INT16_TABLE_BITS = 8;
+
+  private:
+    typedef void (*IdctInt16Function)(const int16_t* coefficients, uint8_t* pixels);
+
+    struct Kernels {
+        Kernels();
+
+        IdctInt16Function idctInt16;
+    };
+
+    static void idctInt16Scalar(const int16_t* coefficients, uint8_t* pixels);
+    static void idctInt16SSE2(const int16_t* coefficients, uint8_t* pixels);
+    static void idctInt16NEON(const int16_t* coefficients, uint8_t* pixels);
+
+  private:
+    static const Kernels sKernels;
+};
+
+#endif // IDCT8X8_H
@@ -1,88 +1,566 @@
 #include "meteordecoder.h"
 
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+
 
 MeteorDecoder::MeteorDecoder(bool deInterleave, bool oqpsk, bool differentialDecode)
     : mDeInterleave(deInterleave)
     , mDifferentialDecode(differentialDecode)
-    , mCorrelation(differentialDecode ? sSynchWordOQPSK : sSynchWordQPSK, oqpsk) {}
+    , mContinuousViterbi(false)
+    , mVerbose(true)
+    , mFrameDescrambler(differentialDecode)
+    , mCorrelation(differentialDecode ? sSynchWordOQPSK : sSynchWordQPSK, oqpsk)
+    , mThreadPool(nullptr)
+    , mWindowOffset(0)
+    , mStreamLength(0)
+    , mSearchPos(0)
+    , mFramePos(0)
+    , mFirstMissPos(0)
+    , mFramesInRun(0)
+    , mTrackMisses(0)
+    , mState(SEARCH)
+    , mPhaseShift(0)
+    , mStatsStream(nullptr)
+    , mStatsInterval(0)
+    , mLastFramePos(0)
+    , mFrameJournal(nullptr)
+    , mStreamStart(0)
+    , mStreamPos(0)
+    , mDecodedBitsOffset(0)
+    , mFrameBit(0) {
+    mFrameDecoders.push_back(std::make_unique<FrameDecoder>());
+    setStats(&mStats);
+}
+
+void MeteorDecoder::setThreadPool(ThreadPool* threadPool, int threads) {
+    mThreadPool = threads > 1 ? threadPool : nullptr;
+    setDecodeThreadPool(mThreadPool);
+
+    const size_t frameDecoders = mThreadPool ? threads * FRAMES_PER_JOB : 1;
+    mFrameDecoders.resize(frameDecoders);
+    for(auto& frameDecoder : mFrameDecoders) {
+        if(!frameDecoder) {
+            frameDecoder = std::make_unique<FrameDecoder>();
+        }
+    }
+}
+
+void MeteorDecoder::setContinuousViterbi(bool enabled) {
+    mContinuousViterbi = enabled && mStreamViterbi.isStreamingSupported();
+}
+
+void MeteorDecoder::setVerbose(bool verbose) {
+    mVerbose = verbose;
+    mDeInterleaver.setVerbose(verbose);
+}
+
+void MeteorDecoder::setStatsOutput(std::ostream* stream, uint32_t intervalFrames) {
+    mStatsStream = stream;
+    mStatsInterval = intervalFrames;
+}
+
+void MeteorDecoder::setFrameJournal(FrameJournal* frameJournal) {
+    mFrameJournal = frameJournal;
+}
+
+size_t MeteorDecoder::decode(const uint8_t* softBits, size_t length) {
+    push(softBits, length);
+
+    return finish();
+}
+
+void MeteorDecoder::push(const uint8_t* softBits, size_t length) {
+    if(!mDeInterleave) {
+        pushSoftBits(softBits, length);
+        return;
+    }
 
-size_t MeteorDecoder::decode(uint8_t* softBits, size_t length) {
-    size_t decodedPacketCounter = 0;
-    size_t syncWordFound = 0;
+    // Chunked, so the deinterleaved copy stays small
+    for(size_t pos = 0; pos < length; pos += DEINTERLEAVE_CHUNK) {
+        mDeInterleaver.push(softBits + pos, std::min<size_t>(DEINTERLEAVE_CHUNK, length - pos), mDeInterleaved);
+        pushSoftBits(mDeInterleaved.data(), mDeInterleaved.size());
+        mDeInterleaved.clear();
+    }
+}
 
+size_t MeteorDecoder::finish() {
     if(mDeInterleave) {
-        std::cout << "Deinterleaving..." << std::endl;
-        uint64_t outLen = 0;
-        DeInterleaver::deInterleave(softBits, length, &outLen);
-        length = outLen;
+        mDeInterleaver.finish(mDeInterleaved);
+        pushSoftBits(mDeInterleaved.data(), mDeInterleaved.size());
+        mDeInterleaved.clear();
+        mDeInterleaved.shrink_to_fit();
     }
 
-    mCorrelation.correlate(softBits, length, [&softBits, length, &decodedPacketCounter, &syncWordFound, this](Correlation::CorellationResult correlationResult, Correlation::PhaseShift phaseShift) {
-        bool packetOk;
-        uint32_t processedBits = 0;
+    process(mWindow.data(), mWindowOffset, mWindow.size(), true);
+    mWindow.clear();
 
-        do {
-            syncWordFound++;
+    reportFinalStats();
 
-            if(length - (correlationResult.pos + processedBits) < 16384) {
-                return processedBits;
-            }
+    return mStats.getFramesPassed();
+}
 
-            memcpy(mDataTodecode, &softBits[correlationResult.pos + processedBits], 16384);
+size_t MeteorDecoder::decodeIndexed(const uint8_t* softBits, size_t length, const std::vector<CaduIndex::Entry>& frames) {
+    return decodeIndexed([softBits](uint64_t pos, size_t count, uint8_t* output) {
+        memcpy(output, &softBits[pos], count);
+    }, length, frames);
+}
 
-            mCorrelation.rotateSoftIqInPlace(mDataTodecode, 16384, phaseShift);
+size_t MeteorDecoder::decodeIndexed(const SoftBitsReader& reader, uint64_t length, const std::vector<CaduIndex::Entry>& frames) {
+    std::vector<uint8_t> input;
+    size_t next = 0;
 
-            mViterbi.decodeSoft(mDataTodecode, mViterbiResult, 16384);
+    if(!mDeInterleave) {
+        // Frames at most a frame apart are read in one span, the soft bits between distant ones are never touched
+        while(next < frames.size()) {
+            const uint64_t offset = std::min<uint64_t>(frames[next].pos, length);
+            const uint64_t limit = std::min<uint64_t>(offset + INDEXED_READ_CHUNK, length);
+            uint64_t end = std::min<uint64_t>(offset + FRAME_SOFT_BITS, length);
+            for(size_t i = next + 1; i < frames.size() && frames[i].pos >= offset && frames[i].pos <= end + FRAME_SOFT_BITS && frames[i].pos + FRAME_SOFT_BITS <= limit; i++) {
+                end = std::max<uint64_t>(end, frames[i].pos + FRAME_SOFT_BITS);
+            }
 
-            if(mDifferentialDecode) {
-                differentialDecode(mViterbiResult, 1024);
+            input.resize(end - offset);
+            if(!input.empty()) {
+                reader(offset, input.size(), input.data());
             }
+            next = decodeIndexedWindow(input.data(), offset, input.size(), frames, next, end == length);
+        }
+    } else {
+        // Positions are in the deinterleaved stream, it is produced in chunks and only kept from the next indexed frame on
+        mWindow.clear();
+        mWindowOffset = 0;
+
+        for(uint64_t pos = 0; pos < length && next < frames.size(); pos += DEINTERLEAVE_CHUNK) {
+            input.resize(std::min<uint64_t>(DEINTERLEAVE_CHUNK, length - pos));
+            reader(pos, input.size(), input.data());
+
+            mDeInterleaver.push(input.data(), input.size(), mWindow);
+            next = decodeIndexedWindow(mWindow.data(), mWindowOffset, mWindow.size(), frames, next, false);
+
+            const uint64_t windowEnd = mWindowOffset + mWindow.size();
+            const uint64_t keepPos = next < frames.size() ? std::min<uint64_t>(std::max<uint64_t>(frames[next].pos, mWindowOffset), windowEnd) : windowEnd;
+            mWindow.erase(mWindow.begin(), mWindow.begin() + (keepPos - mWindowOffset));
+            mWindowOffset = keepPos;
+        }
+
+        mDeInterleaver.finish(mWindow);
+        decodeIndexedWindow(mWindow.data(), mWindowOffset, mWindow.size(), frames, next, true);
+        mWindow.clear();
+        mWindow.shrink_to_fit();
+    }
+
+    reportFinalStats();
+
+    return mStats.getFramesPassed();
+}
 
-            uint32_t last_sync_ = *reinterpret_cast<uint32_t*>(mViterbiResult);
+size_t MeteorDecoder::decodeIndexedWindow(const uint8_t* softBits, uint64_t offset, uint64_t length, const std::vector<CaduIndex::Entry>& frames, size_t next, bool lastBlock) {
+    const uint64_t end = offset + length;
 
-            for(int j = 0; j < 1024 - 4; j++) {
-                mViterbiResult[j + 4] = mViterbiResult[j + 4] ^ PRAND[j % 255];
+    std::vector<CaduIndex::Entry> batch;
+    while(next < frames.size()) {
+        batch.clear();
+        for(; next < frames.size() && batch.size() < mFrameDecoders.size(); next++) {
+            if(frames[next].pos < offset) {
+                // Out of order entry, its soft bits are already dropped
+                continue;
             }
+            if(frames[next].pos + FRAME_SOFT_BITS > end) {
+                if(!lastBlock) {
+                    break;
+                }
+                continue;
+            }
+            batch.push_back(frames[next]);
+        }
+
+        if(batch.empty()) {
+            break;
+        }
+
+        decodeIndexedFrames(softBits, offset, batch);
+
+        for(size_t i = 0; i < batch.size(); i++) {
+            mPhaseShift = batch[i].phaseShift;
+            mStats.syncWordFound();
+            consumeFrame(*mFrameDecoders[i]);
+        }
+    }
+
+    return next;
+}
+
+void MeteorDecoder::pushSoftBits(const uint8_t* softBits, size_t length) {
+    uint64_t keepPos;
+
+    if(mWindow.empty()) {
+        // Work directly on the caller's buffer, only the unprocessed tail is copied
+        keepPos = process(softBits, mStreamLength, length, false);
+        mWindow.assign(softBits + (keepPos - mStreamLength), softBits + length);
+    } else {
+        mWindow.insert(mWindow.end(), softBits, softBits + length);
+        keepPos = process(mWindow.data(), mWindowOffset, mWindow.size(), false);
+        mWindow.erase(mWindow.begin(), mWindow.begin() + (keepPos - mWindowOffset));
+    }
+
+    mWindowOffset = keepPos;
+    mStreamLength += length;
+}
+
+uint64_t MeteorDecoder::process(const uint8_t* softBits, uint64_t offset, uint64_t length, bool lastBlock) {
+    const uint64_t end = offset + length;
+    Correlation::CorellationResult correlationResult;
+    Correlation::PhaseShift phaseShift;
+
+    while(true) {
+        switch(mState) {
+            case SEARCH:
+                if(mSearchPos + 64 >= end) {
+                    return std::min(mSearchPos, end);
+                }
+
+                if(!mCorrelation.findSync(&softBits[mSearchPos - offset], end - mSearchPos, correlationResult, phaseShift)) {
+                    mSearchPos = end - 64;
+                    return mSearchPos;
+                }
+
+                mFramePos = mSearchPos + correlationResult.pos;
+                mPhaseShift = phaseShift;
+                mFramesInRun = 0;
 
-            if(mViterbiResult[9] == 0xFF) {
-                for(int i = 0; i < 1024; i++) {
-                    mViterbiResult[i] ^= 0xFF;
+                if(mContinuousViterbi) {
+                    startStream(mFramePos);
+                } else {
+                    mState = FRAME_RUN;
                 }
+                break;
+
+            case STREAMING:
+                if(!processStream(softBits, offset, end, lastBlock)) {
+                    return lastBlock ? end : streamKeepPos();
+                }
+                break;
+
+            case FRAME_RUN:
+                if(end - mFramePos < FRAME_SOFT_BITS) {
+                    if(!lastBlock) {
+                        return mFramePos;
+                    }
+                    mStats.syncWordFound();
+                    mSearchPos = mFramePos + 1;
+                    mState = SEARCH;
+                    break;
+                }
+
+                {
+                    // The following frames of the run are decoded speculatively, results after a failed frame are dropped
+                    const size_t frames = std::min<uint64_t>(mFrameDecoders.size(), (end - mFramePos) / FRAME_SOFT_BITS);
+                    decodeFrames(&softBits[mFramePos - offset], mFramePos, frames);
+
+                    for(size_t i = 0; i < frames && mState == FRAME_RUN; i++) {
+                        mStats.syncWordFound();
+
+                        if(consumeFrame(*mFrameDecoders[i])) {
+                            mFramePos += FRAME_SOFT_BITS;
+                            mFramesInRun++;
+                        } else if(mFramesInRun > 0) {
+                            // Keep the phase and predict the next sync word instead of searching the whole stream again
+                            mFirstMissPos = mFramePos;
+                            mTrackMisses = 1;
+                            mFramePos += FRAME_SOFT_BITS;
+                            mState = TRACKING;
+                        } else {
+                            mSearchPos = mFramePos + 1;
+                            mState = SEARCH;
+                        }
+                    }
+                }
+                break;
+
+            case TRACKING: {
+                const uint64_t windowStart = mFramePos > TRACKING_WINDOW ? mFramePos - TRACKING_WINDOW : 0;
+                const uint64_t windowEnd = mFramePos + TRACKING_WINDOW;
+
+                if(end < windowEnd + FRAME_SOFT_BITS) {
+                    if(!lastBlock) {
+                        return std::min(mFirstMissPos + 1, windowStart);
+                    }
+                    mSearchPos = mFirstMissPos + 1;
+                    mState = SEARCH;
+                    break;
+                }
+
+                // Only the known phase is checked around the predicted position
+                uint64_t framePos = mFramePos;
+                if(mCorrelation.findBestSync(&softBits[windowStart - offset], windowEnd - windowStart + 65, mPhaseShift, correlationResult)) {
+                    framePos = windowStart + correlationResult.pos;
+                }
+
+                mStats.syncWordFound();
+
+                decodeFrame(*mFrameDecoders[0], &softBits[framePos - offset], framePos, mPhaseShift);
+                if(consumeFrame(*mFrameDecoders[0])) {
+                    mFramePos = framePos + FRAME_SOFT_BITS;
+                    mFramesInRun++;
+                    mState = FRAME_RUN;
+                } else if(++mTrackMisses >= TRACKING_MAX_MISSES) {
+                    // Lost track, possibly a phase slip, fall back to the full search after the first missed frame
+                    mStats.syncLost();
+                    mSearchPos = mFirstMissPos + 1;
+                    mState = SEARCH;
+                } else {
+                    mFramePos = framePos + FRAME_SOFT_BITS;
+                }
+                break;
             }
+        }
+    }
+}
+
+void MeteorDecoder::decodeFrames(const uint8_t* softBits, uint64_t pos, size_t frames) {
+    if(mThreadPool == nullptr || frames <= 1) {
+        for(size_t i = 0; i < frames; i++) {
+            decodeFrame(*mFrameDecoders[i], &softBits[i * FRAME_SOFT_BITS], pos + i * FRAME_SOFT_BITS, mPhaseShift);
+        }
+        return;
+    }
 
-            for(int i = 0; i < 4; i++) {
-                mReedSolomon.deinterleave(mViterbiResult + 4, i, 4);
-                rsResult[i] = mReedSolomon.decode();
-                mReedSolomon.interleave(mDecodedPacket, i, 4);
+    for(size_t first = 0; first < frames; first += FRAMES_PER_JOB) {
+        const size_t last = std::min<size_t>(first + FRAMES_PER_JOB, frames);
+        const Correlation::PhaseShift phaseShift = mPhaseShift;
+
+        mThreadPool->addJob([this, softBits, pos, first, last, phaseShift]() {
+            for(size_t i = first; i < last; i++) {
+                decodeFrame(*mFrameDecoders[i], &softBits[i * FRAME_SOFT_BITS], pos + i * FRAME_SOFT_BITS, phaseShift);
             }
+        }, mFrameJobs);
+    }
+    mFrameJobs.wait();
+}
 
-            std::cout << "SyncWordFound:" << syncWordFound << " | Decoded Packets:" << decodedPacketCounter << " | Current Pos:" << (correlationResult.pos + processedBits) << " | Phase:" << phaseShift << " | synch:" << std::hex
-                      << last_sync_ << " | RS: (" << std::dec << rsResult[0] << ", " << rsResult[1] << ", " << rsResult[2] << ", " << rsResult[3] << ")"
-                      << "\t\t\r";
+void MeteorDecoder::decodeIndexedFrames(const uint8_t* softBits, uint64_t offset, const std::vector<CaduIndex::Entry>& frames) {
+    if(mThreadPool == nullptr || frames.size() <= 1) {
+        for(size_t i = 0; i < frames.size(); i++) {
+            decodeFrame(*mFrameDecoders[i], &softBits[frames[i].pos - offset], frames[i].pos, frames[i].phaseShift);
+        }
+        return;
+    }
 
-            packetOk = (rsResult[0] != -1) && (rsResult[1] != -1) && (rsResult[2] != -1) && (rsResult[3] != -1);
+    for(size_t first = 0; first < frames.size(); first += FRAMES_PER_JOB) {
+        const size_t last = std::min<size_t>(first + FRAMES_PER_JOB, frames.size());
 
-            if(packetOk) {
-                parseFrame(mDecodedPacket, 892);
-                decodedPacketCounter++;
-                processedBits += 16384;
+        mThreadPool->addJob([this, softBits, offset, &frames, first, last]() {
+            for(size_t i = first; i < last; i++) {
+                decodeFrame(*mFrameDecoders[i], &softBits[frames[i].pos - offset], frames[i].pos, frames[i].phaseShift);
             }
-        } while(packetOk);
+        }, mFrameJobs);
+    }
+    mFrameJobs.wait();
+}
+
+void MeteorDecoder::decodeFrame(FrameDecoder& frame, const uint8_t* softBits, uint64_t pos, Correlation::PhaseShift phaseShift) const {
+    memcpy(frame.dataToDecode, softBits, FRAME_SOFT_BITS);
+
+    Correlation::rotateSoftIqInPlace(frame.dataToDecode, FRAME_SOFT_BITS, phaseShift);
+
+    frame.viterbi.decodeSoft(frame.dataToDecode, frame.viterbiResult, FRAME_SOFT_BITS);
+
+    correctFrame(frame, pos);
+}
+
+void MeteorDecoder::correctFrame(FrameDecoder& frame, uint64_t pos) const {
+    frame.lastSync = mFrameDescrambler.process(frame.viterbiResult);
 
-        return (processedBits > 0) ? processedBits - 1 : 0;
-    });
+    // Corrects the codewords in place, the first 892 bytes are the interleaved VCDU afterwards
+    frame.reedSolomon.decodeInterleaved(frame.viterbiResult + 4, frame.rsResult);
+
+    frame.pos = pos;
+    frame.packetOk = (frame.rsResult[0] != -1) && (frame.rsResult[1] != -1) && (frame.rsResult[2] != -1) && (frame.rsResult[3] != -1);
+}
+
+bool MeteorDecoder::consumeFrame(FrameDecoder& frame) {
+    mStats.frame(frame.rsResult, 4, mPhaseShift, frame.packetOk);
+    mLastFramePos = frame.pos;
+
+    if(frame.packetOk) {
+        parseFrame(frame.viterbiResult + 4, 892);
+        mConfirmedFrames.push_back({frame.pos, mPhaseShift, mDeInterleave ? mDeInterleaver.inputPosition(frame.pos) : frame.pos});
+        if(mFrameJournal) {
+            mFrameJournal->write(frame.viterbiResult + 4);
+        }
+    }
+
+    const uint64_t framesTried = mStats.getFramesTried();
+    if(mVerbose && framesTried % STATUS_INTERVAL == 0) {
+        printStatus();
+    }
+    if(mStatsStream && mStatsInterval > 0 && framesTried % mStatsInterval == 0) {
+        mStats.writeJson(*mStatsStream);
+        *mStatsStream << "\n";
+    }
+
+    return frame.packetOk;
+}
+
+void MeteorDecoder::reportFinalStats() {
+    flushMCUs();
+
+    if(mVerbose) {
+        printStatus();
+        std::cout << std::endl;
+    }
+    if(mStatsStream) {
+        mStats.writeJson(*mStatsStream);
+        *mStatsStream << std::endl;
+    }
+}
+
+void MeteorDecoder::printStatus() const {
+    std::cout << "SyncWordFound:" << mStats.getSyncWords() << " | Decoded Packets:" << mStats.getFramesPassed() << "/" << mStats.getFramesTried() << " | Sync lost:" << mStats.getSyncLosses()
+              << " | RS corrected:" << mStats.getRsCorrectedSymbols() << " | Current Pos:" << mLastFramePos << " | Phase:" << mPhaseShift << "\t\t\r" << std::flush;
+}
 
-    std::cout << std::endl;
+void MeteorDecoder::startStream(uint64_t framePos) {
+    // Starting a little ahead of the frame gives the trellis time to settle before the sync word
+    const uint64_t warmup = std::min(STREAM_WARMUP, (framePos - mSearchPos) / 2);
 
-    return decodedPacketCounter;
+    mStreamViterbi.resetStream();
+    mDecodedBits.clear();
+    mDecodedBitsOffset = 0;
+    mStreamStart = framePos - warmup * 2;
+    mStreamPos = mStreamStart;
+    mFrameBit = warmup;
+    mTrackMisses = 0;
+    mState = STREAMING;
 }
 
-void MeteorDecoder::differentialDecode(uint8_t* data, int64_t len) {
-    uint8_t mask;
-    uint8_t lastBit = 0;
-    for(int i = 0; i < len; i++) {
-        mask = ((data[i] >> 1) & 0x7F) | (lastBit << 7);
-        lastBit = data[i] & 1;
-        data[i] ^= mask;
+// Returns true when the stream was lost and the state changed, false when all available input was used
+bool MeteorDecoder::processStream(const uint8_t* softBits, uint64_t offset, uint64_t end, bool lastBlock) {
+    const uint64_t length = (end - mStreamPos) & ~uint64_t(1);
+    if(length > 0) {
+        mRotatedSoftBits.assign(&softBits[mStreamPos - offset], &softBits[mStreamPos - offset + length]);
+        Correlation::rotateSoftIqInPlace(mRotatedSoftBits.data(), static_cast<uint32_t>(length), mPhaseShift);
+        mStreamViterbi.decodeStream(mRotatedSoftBits.data(), length, mDecodedBits);
+        mStreamPos += length;
     }
-}
\ No newline at end of file
+    if(lastBlock) {
+        mStreamViterbi.flushStream(mDecodedBits);
+    }
+
+    const uint64_t decodedEnd = mDecodedBitsOffset + mDecodedBits.size();
+    FrameDecoder& frame = *mFrameDecoders[0];
+
+    while(decodedEnd >= mFrameBit + FRAME_BITS) {
+        uint64_t frameBit = mFrameBit;
+        bool found = asmBitErrors(frameBit) <= ASM_TRACKING_MAX_BIT_ERRORS;
+
+        if(!found) {
+            // The next sync word is searched up to one frame ahead
+            if(decodedEnd < mFrameBit + 2 * FRAME_BITS && !lastBlock) {
+                break;
+            }
+            const uint64_t first = std::max(std::max(mFrameBit, uint64_t(TRACKING_WINDOW / 2)) - TRACKING_WINDOW / 2, mDecodedBitsOffset);
+            const uint64_t last = std::min<uint64_t>(mFrameBit + FRAME_BITS, decodedEnd - FRAME_BITS);
+            found = findAsm(first, last, frameBit);
+        }
+
+        bool packetOk = false;
+        if(found) {
+            const uint8_t* bits = &mDecodedBits[frameBit - mDecodedBitsOffset];
+            for(uint32_t i = 0; i < FRAME_BITS / 8; i++) {
+                uint8_t byte = 0;
+                for(int k = 0; k < 8; k++) {
+                    byte = (byte << 1) | bits[i * 8 + k];
+                }
+                frame.viterbiResult[i] = byte;
+            }
+
+            mStats.syncWordFound();
+            correctFrame(frame, streamSoftPos(frameBit));
+            packetOk = consumeFrame(frame);
+            mFrameBit = frameBit + FRAME_BITS;
+        } else {
+            mFrameBit += FRAME_BITS;
+        }
+
+        if(packetOk) {
+            mTrackMisses = 0;
+            continue;
+        }
+
+        if(mTrackMisses++ == 0) {
+            mFirstMissPos = streamSoftPos(frameBit);
+        }
+        if(mTrackMisses >= TRACKING_MAX_MISSES) {
+            // Lost the stream, possibly a phase slip, the soft correlator has to find the phase again
+            mStats.syncLost();
+            mSearchPos = mFirstMissPos + 1;
+            mState = SEARCH;
+            return true;
+        }
+    }
+
+    // Only the bits the next sync word search can reach are kept
+    const uint64_t keepBit = std::max(mFrameBit, uint64_t(TRACKING_WINDOW / 2)) - TRACKING_WINDOW / 2;
+    if(keepBit > mDecodedBitsOffset) {
+        const uint64_t drop = std::min<uint64_t>(keepBit - mDecodedBitsOffset, mDecodedBits.size());
+        mDecodedBits.erase(mDecodedBits.begin(), mDecodedBits.begin() + drop);
+        mDecodedBitsOffset += drop;
+    }
+
+    return false;
+}
+
+// The soft bits have to be kept from where the soft search restarts if the stream gets lost
+uint64_t MeteorDecoder::streamKeepPos() const {
+    if(mTrackMisses > 0) {
+        return std::min(mStreamPos, mFirstMissPos);
+    }
+    return std::min(mStreamPos, streamSoftPos(mFrameBit));
+}
+
+int MeteorDecoder::asmBitErrors(uint64_t bit) const {
+    const uint8_t* bits = &mDecodedBits[bit - mDecodedBitsOffset];
+    uint8_t lastBit = (mDifferentialDecode && bit > mDecodedBitsOffset) ? bits[-1] : 0;
+    uint32_t word = 0;
+
+    for(int i = 0; i < 32; i++) {
+        word = (word << 1) | (mDifferentialDecode ? bits[i] ^ lastBit : bits[i]);
+        lastBit = bits[i];
+    }
+
+    // Without differential coding the Viterbi output may be inverted
+    const int errors = Correlation::countBits(word ^ ASM);
+    return mDifferentialDecode ? errors : std::min(errors, 32 - errors);
+}
+
+// First sync word starting in [first, last], searched with a sliding register over the decoded bits
+bool MeteorDecoder::findAsm(uint64_t first, uint64_t last, uint64_t& bit) const {
+    if(last < first) {
+        return false;
+    }
+
+    const uint8_t* bits = &mDecodedBits[first - mDecodedBitsOffset];
+    uint8_t lastBit = (mDifferentialDecode && first > mDecodedBitsOffset) ? bits[-1] : 0;
+    uint32_t word = 0;
+
+    for(uint64_t i = 0; i < last - first + 32; i++) {
+        word = (word << 1) | (mDifferentialDecode ? bits[i] ^ lastBit : bits[i]);
+        lastBit = bits[i];
+
+        if(i < 31) {
+            continue;
+        }
+
+        const int errors = Correlation::countBits(word ^ ASM);
+        if(errors <= ASM_SEARCH_MAX_BIT_ERRORS || (!mDifferentialDecode && 32 - errors <= ASM_SEARCH_MAX_BIT_ERRORS)) {
+            bit = first + i - 31;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -4,45 +4,169 @@
 #include <stdint.h>
 
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
 
+#include "caduindex.h"
 #include "correlation.h"
+#include "decoderstats.h"
 #include "deinterleaver.h"
+#include "framedescrambler.h"
+#include "framejournal.h"
 #include "packetparser.h"
 #include "reedsolomon.h"
+#include "threadpool.h"
 #include "viterbi.h"
 
 class MeteorDecoder : public PacketParser {
-  private:
-    static constexpr uint8_t PRAND[]
-        = {0xff, 0x48, 0x0e, 0xc0, 0x9a, 0x0d, 0x70, 0xbc, 0x8e, 0x2c, 0x93, 0xad, 0xa7, 0xb7, 0x46, 0xce, 0x5a, 0x97, 0x7d, 0xcc, 0x32, 0xa2, 0xbf, 0x3e, 0x0a, 0x10, 0xf1, 0x88, 0x94, 0xcd, 0xea, 0xb1, 0xfe, 0x90, 0x1d, 0x81, 0x34,
-           0x1a, 0xe1, 0x79, 0x1c, 0x59, 0x27, 0x5b, 0x4f, 0x6e, 0x8d, 0x9c, 0xb5, 0x2e, 0xfb, 0x98, 0x65, 0x45, 0x7e, 0x7c, 0x14, 0x21, 0xe3, 0x11, 0x29, 0x9b, 0xd5, 0x63, 0xfd, 0x20, 0x3b, 0x02, 0x68, 0x35, 0xc2, 0xf2, 0x38, 0xb2,
-           0x4e, 0xb6, 0x9e, 0xdd, 0x1b, 0x39, 0x6a, 0x5d, 0xf7, 0x30, 0xca, 0x8a, 0xfc, 0xf8, 0x28, 0x43, 0xc6, 0x22, 0x53, 0x37, 0xaa, 0xc7, 0xfa, 0x40, 0x76, 0x04, 0xd0, 0x6b, 0x85, 0xe4, 0x71, 0x64, 0x9d, 0x6d, 0x3d, 0xba, 0x36,
-           0x72, 0xd4, 0xbb, 0xee, 0x61, 0x95, 0x15, 0xf9, 0xf0, 0x50, 0x87, 0x8c, 0x44, 0xa6, 0x6f, 0x55, 0x8f, 0xf4, 0x80, 0xec, 0x09, 0xa0, 0xd7, 0x0b, 0xc8, 0xe2, 0xc9, 0x3a, 0xda, 0x7b, 0x74, 0x6c, 0xe5, 0xa9, 0x77, 0xdc, 0xc3,
-           0x2a, 0x2b, 0xf3, 0xe0, 0xa1, 0x0f, 0x18, 0x89, 0x4c, 0xde, 0xab, 0x1f, 0xe9, 0x01, 0xd8, 0x13, 0x41, 0xae, 0x17, 0x91, 0xc5, 0x92, 0x75, 0xb4, 0xf6, 0xe8, 0xd9, 0xcb, 0x52, 0xef, 0xb9, 0x86, 0x54, 0x57, 0xe7, 0xc1, 0x42,
-           0x1e, 0x31, 0x12, 0x99, 0xbd, 0x56, 0x3f, 0xd2, 0x03, 0xb0, 0x26, 0x83, 0x5c, 0x2f, 0x23, 0x8b, 0x24, 0xeb, 0x69, 0xed, 0xd1, 0xb3, 0x96, 0xa5, 0xdf, 0x73, 0x0c, 0xa8, 0xaf, 0xcf, 0x82, 0x84, 0x3c, 0x62, 0x25, 0x33, 0x7a,
-           0xac, 0x7f, 0xa4, 0x07, 0x60, 0x4d, 0x06, 0xb8, 0x5e, 0x47, 0x16, 0x49, 0xd6, 0xd3, 0xdb, 0xa3, 0x67, 0x2d, 0x4b, 0xbe, 0xe6, 0x19, 0x51, 0x5f, 0x9f, 0x05, 0x08, 0x78, 0xc4, 0x4a, 0x66, 0xf5, 0x58};
-
+  public:
+    // Copies length soft bits from pos on into softBits, for inputs which are not kept in memory as a whole
+    typedef std::function<void(uint64_t pos, size_t length, uint8_t* softBits)> SoftBitsReader;
 
   public:
     MeteorDecoder() = delete;
     MeteorDecoder(bool deInterleave, bool oqpsk, bool differentialDecode);
 
-    size_t decode(uint8_t* softBits, size_t length);
+    size_t decode(const uint8_t* softBits, size_t length);
+
+    // Incremental decoding, only a sliding window of the soft bits is kept between calls
+    void push(const uint8_t* softBits, size_t length);
+    size_t finish();
+
+    // Decodes only the given frames without searching sync words, frames of a batch are decoded in parallel when a thread pool is set
+    size_t decodeIndexed(const uint8_t* softBits, size_t length, const std::vector<CaduIndex::Entry>& frames);
+
+    // Only the spans of the indexed frames are read, with deinterleaving the input is read up to the last frame
+    size_t decodeIndexed(const SoftBitsReader& reader, uint64_t length, const std::vector<CaduIndex::Entry>& frames);
+
+    // Position and phase of every frame which passed the RS decoder, in stream order
+    const std::vector<CaduIndex::Entry>& getConfirmedFrames() const {
+        return mConfirmedFrames;
+    }
+
+    // Frames predicted inside a run are decoded ahead on the pool and parsed in stream order, threads <= 1 decodes on the caller's thread
+    void setThreadPool(ThreadPool* threadPool, int threads);
+
+    // Decodes every soft bit once with a continuous Viterbi decoder and searches the sync words in the decoded bits.
+    // Frames are decoded sequentially, the soft correlator is only used to find the phase again after the stream was lost
+    void setContinuousViterbi(bool enabled);
+
+    // Progress is printed to the console by default
+    void setVerbose(bool verbose);
+
+    size_t getSyncWordCount() const {
+        return mStats.getSyncWords();
+    }
+
+    // JSON lines are written every intervalFrames consumed frames and after the last one, 0 writes only the final statistics
+    void setStatsOutput(std::ostream* stream, uint32_t intervalFrames);
+
+    // Every frame which passed the RS decoder is appended to the journal
+    void setFrameJournal(FrameJournal* frameJournal);
+
+    const DecoderStats& getStats() const {
+        return mStats;
+    }
+
+  private:
+    enum State { SEARCH, FRAME_RUN, TRACKING, STREAMING };
+
+    // Everything needed to decode one CADU, one instance per frame of a parallel batch
+    struct FrameDecoder {
+        uint8_t dataToDecode[16384];
+        uint8_t viterbiResult[1024];
+        int rsResult[4];
+        uint32_t lastSync;
+        uint64_t pos;
+        bool packetOk;
+        Viterbi viterbi;
+        ReedSolomon reedSolomon;
+    };
 
   private:
     bool mDeInterleave;
     bool mDifferentialDecode;
-    uint8_t mDataTodecode[16384];
-    uint8_t mViterbiResult[1024];
-    uint8_t mDecodedPacket[1024];
-    uint16_t mIntSqrtTable[32768];
-    int rsResult[4];
+    bool mContinuousViterbi;
+    bool mVerbose;
+    FrameDescrambler mFrameDescrambler;
     Correlation mCorrelation;
-    Viterbi mViterbi;
-    ReedSolomon mReedSolomon;
+    ThreadPool* mThreadPool;
+    // Frame decode jobs of the current batch, the pool is shared with other work
+    ThreadPool::JobCounter mFrameJobs;
+    std::vector<std::unique_ptr<FrameDecoder>> mFrameDecoders;
+
+    std::vector<uint8_t> mWindow;
+    DeInterleaver mDeInterleaver;
+    std::vector<uint8_t> mDeInterleaved;
+    uint64_t mWindowOffset;
+    uint64_t mStreamLength;
+    uint64_t mSearchPos;
+    uint64_t mFramePos;
+    uint64_t mFirstMissPos;
+    uint32_t mFramesInRun;
+    uint32_t mTrackMisses;
+    State mState;
+    Correlation::PhaseShift mPhaseShift;
+    DecoderStats mStats;
+    std::ostream* mStatsStream;
+    uint32_t mStatsInterval;
+    uint64_t mLastFramePos;
+    std::vector<CaduIndex::Entry> mConfirmedFrames;
+    FrameJournal* mFrameJournal;
+
+    // Continuous Viterbi mode, decoded bit n belongs to the soft bit pair at mStreamStart + 2 * n
+    Viterbi mStreamViterbi;
+    std::vector<uint8_t> mRotatedSoftBits;
+    std::vector<uint8_t> mDecodedBits;
+    uint64_t mStreamStart;
+    uint64_t mStreamPos;
+    uint64_t mDecodedBitsOffset;
+    uint64_t mFrameBit;
+
+  private:
+    void pushSoftBits(const uint8_t* softBits, size_t length);
+    uint64_t process(const uint8_t* softBits, uint64_t offset, uint64_t length, bool lastBlock);
+    void decodeFrames(const uint8_t* softBits, uint64_t pos, size_t frames);
+    // Decodes the indexed frames from next on which are complete in the window, returns the first one which is not
+    size_t decodeIndexedWindow(const uint8_t* softBits, uint64_t offset, uint64_t length, const std::vector<CaduIndex::Entry>& frames, size_t next, bool lastBlock);
+    void decodeIndexedFrames(const uint8_t* softBits, uint64_t offset, const std::vector<CaduIndex::Entry>& frames);
+    void decodeFrame(FrameDecoder& frame, const uint8_t* softBits, uint64_t pos, Correlation::PhaseShift phaseShift) const;
+    void correctFrame(FrameDecoder& frame, uint64_t pos) const;
+    bool consumeFrame(FrameDecoder& frame);
+    void printStatus() const;
+    void reportFinalStats();
+
+    void startStream(uint64_t framePos);
+    bool processStream(const uint8_t* softBits, uint64_t offset, uint64_t end, bool lastBlock);
+    uint64_t streamKeepPos() const;
+    int asmBitErrors(uint64_t bit) const;
+    bool findAsm(uint64_t first, uint64_t last, uint64_t& bit) const;
+
+    uint64_t streamSoftPos(uint64_t bit) const {
+        return mStreamStart + 2 * bit;
+    }
 
   private:
-    void differentialDecode(uint8_t* data, int64_t len);
+    static constexpr uint32_t FRAME_SOFT_BITS = 16384;
+    // Maximum distance of the sync word from its predicted position while tracking
+    static constexpr uint32_t TRACKING_WINDOW = 32;
+    static constexpr uint32_t TRACKING_MAX_MISSES = 4;
+    static constexpr uint32_t FRAMES_PER_JOB = 4;
+    static constexpr size_t DEINTERLEAVE_CHUNK = 1024 * 1024;
+    // Longest span of indexed frames read at once
+    static constexpr size_t INDEXED_READ_CHUNK = 1024 * 1024;
+    // Frames between console status lines
+    static constexpr uint64_t STATUS_INTERVAL = 16;
+
+    static constexpr uint32_t FRAME_BITS = FRAME_SOFT_BITS / 2;
+    static constexpr uint32_t ASM = 0x1ACFFC1D;
+    // Sync word bit errors accepted at the predicted position and anywhere else
+    static constexpr int ASM_TRACKING_MAX_BIT_ERRORS = 8;
+    static constexpr int ASM_SEARCH_MAX_BIT_ERRORS = 2;
+    // Soft bit pairs decoded ahead of the first frame of a stream
+    static constexpr uint64_t STREAM_WARMUP = 64;
 
   private:
     static constexpr uint64_t sSynchWordQPSK = 0xFCA2B63DB00D9794U;
@@ -1,11 +1,13 @@
 #include "meteorimage.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <opencv2/imgcodecs.hpp>
 #include <sstream>
 
 #include "bitio.h"
+#include "idct8x8.h"
 
 const uint MCU_PER_PACKET = 14;
 const uint MCU_PER_LINE = 196;
@@ -13,218 +15,264 @@ const uint MCU_PER_LINE = 196;
 const std::array<uint8_t, 64> STANDARD_QUANTIZATION_TABLE{16, 11, 10, 16, 24, 40,  51,  61, 12, 12, 14, 19, 26, 58,  60,  55, 14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
                                                           18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
 
-const std::array<uint8_t, 64> ZIGZAG{0,  1,  5,  6,  14, 15, 27, 28, 2,  4,  7,  13, 16, 26, 29, 42, 3,  8,  12, 17, 25, 30, 41, 43, 9,  11, 18, 24, 31, 40, 44, 53,
-                                     10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60, 21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
+// Natural order position of the zigzag ordered coefficients
+const std::array<uint8_t, 64> NATURAL_ORDER{0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
 
-const std::array<uint8_t, 178> T_AC_0{0,   2,   1,   3,   3,   2,   4,   3,   5,   5,   4,   4,   0,   0,   1,   125, 1,   2,   3,   0,   4,   17,  5,   18,  33,  49,  65,  6,   19,  81,  97,  7,   34,  113, 20,  50,
+constexpr std::array<uint8_t, 178> T_AC_0{0,   2,   1,   3,   3,   2,   4,   3,   5,   5,   4,   4,   0,   0,   1,   125, 1,   2,   3,   0,   4,   17,  5,   18,  33,  49,  65,  6,   19,  81,  97,  7,   34,  113, 20,  50,
                                       129, 145, 161, 8,   35,  66,  177, 193, 21,  82,  209, 240, 36,  51,  98,  114, 130, 9,   10,  22,  23,  24,  25,  26,  37,  38,  39,  40,  41,  42,  52,  53,  54,  55,  56,  57,
                                       58,  67,  68,  69,  70,  71,  72,  73,  74,  83,  84,  85,  86,  87,  88,  89,  90,  99,  100, 101, 102, 103, 104, 105, 106, 115, 116, 117, 118, 119, 120, 121, 122, 131, 132, 133,
                                       134, 135, 136, 137, 138, 146, 147, 148, 149, 150, 151, 152, 153, 154, 162, 163, 164, 165, 166, 167, 168, 169, 170, 178, 179, 180, 181, 182, 183, 184, 185, 186, 194, 195, 196, 197,
                                       198, 199, 200, 201, 202, 210, 211, 212, 213, 214, 215, 216, 217, 218, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 241, 242, 243, 244, 245, 246, 247, 248, 249, 250};
 
-const std::array<int, 12> DC_CAT_OFF{2, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9};
+// Length and code of the DC categories
+constexpr std::array<std::array<uint16_t, 2>, 12> DC_CODES{{{2, 0x000}, {3, 0x002}, {3, 0x003}, {3, 0x004}, {3, 0x005}, {3, 0x006}, {4, 0x00e}, {5, 0x01e}, {6, 0x03e}, {7, 0x07e}, {8, 0x0fe}, {9, 0x1fe}}};
 
+// The lookup tables are generated at compile time and shared by every instance.
+// DC_LOOKUP and AC_CODE_LOOKUP entries are 0 for invalid codes.
 
-MeteorImage::MeteorImage()
-    : mIsChannel64Available(false)
-    , mIsChannel65Available(false)
-    , mIsChannel66Available(false)
-    , mIsChannel68Available(false)
-    , mLastMCU(-1)
-    , mCurY(0)
-    , mLastY(-1)
-    , mFirstPacket(0)
-    , mPrevPacket(0) {
-    initHuffmanTable();
-    initCos();
-}
+constexpr int DC_LOOKUP_BITS = 9;
+constexpr int AC_FAST_BITS = 12;
+constexpr uint8_t AC_FAST_EOB = 0xff;
 
-void MeteorImage::initCos() {
-    for(int y = 0; y < 8; y++) {
-        for(int x = 0; x < 8; x++) {
-            mCosine[y][x] = cos(M_PI / 16 * (2 * y + 1) * x);
-        }
-    }
-    for(int x = 0; x < 8; x++) {
-        if(x == 0)
-            mAlpha[x] = 1 / sqrt(2);
-        else
-            mAlpha[x] = 1;
-    }
+struct AcCode {
+    uint8_t run;
+    uint8_t size;
+    uint8_t len;
+    uint16_t code;
+};
 
-    // for (auto x : cosine_) for (auto y: x) std::cout << std::dec << y << ' ';
-}
+// AC code and its value bits resolved by a single lookup, len == 0 if they do not fit into AC_FAST_BITS
+struct AcFastEntry {
+    int16_t value;
+    uint8_t run;
+    uint8_t len;
+};
 
-void MeteorImage::initHuffmanTable() {
-    std::array<uint8_t, 65536> v{};
-    std::array<uint16_t, 17> min_code{}, maj_code{};
+constexpr int mapRange(int cat, int vl) {
+    int maxval = (1 << cat) - 1;
+    bool sig = (vl >> (cat - 1)) != 0;
+    if(sig)
+        return vl;
+    else
+        return vl - maxval;
+}
 
+// Canonical Huffman codes of T_AC_0
+constexpr std::array<AcCode, 162> makeAcCodes() {
+    std::array<AcCode, 162> codes{};
+    uint32_t code = 0;
     int p = 16;
-    for(int k = 1; k < 17; k++) {
-        for(int i = 0; i < T_AC_0[k - 1]; i++) {
-            v[(k << 8) + i] = T_AC_0[p];
+    int n = 0;
+    for(int len = 1; len < 17; len++) {
+        for(int i = 0; i < T_AC_0[len - 1]; i++) {
+            codes[n] = {static_cast<uint8_t>(T_AC_0[p] >> 4), static_cast<uint8_t>(T_AC_0[p] & 0xf), static_cast<uint8_t>(len), static_cast<uint16_t>(code)};
+            code++;
             p++;
+            n++;
         }
+        code <<= 1;
     }
+    return codes;
+}
 
-    uint32_t code = 0;
-    for(int k = 1; k < 17; k++) {
-        min_code[k] = code;
-        code += T_AC_0[k - 1];
-        maj_code[k] = code - (uint32_t)(code != 0);
-        code *= 2;
-        if(T_AC_0[k - 1] == 0) {
-            min_code[k] = 0xffff;
-            maj_code[k] = 0;
+constexpr std::array<AcCode, 162> AC_CODES = makeAcCodes();
+
+// (len << 4) | category, indexed by the next DC_LOOKUP_BITS bits
+constexpr std::array<uint8_t, 1 << DC_LOOKUP_BITS> makeDcLookup() {
+    std::array<uint8_t, 1 << DC_LOOKUP_BITS> lookup{};
+    for(int cat = 0; cat < 12; cat++) {
+        int len = DC_CODES[cat][0];
+        uint32_t first = DC_CODES[cat][1] << (DC_LOOKUP_BITS - len);
+        for(uint32_t i = 0; i < (1u << (DC_LOOKUP_BITS - len)); i++) {
+            lookup[first + i] = static_cast<uint8_t>((len << 4) | cat);
         }
     }
+    return lookup;
+}
 
-    int n = 0;
-    for(int k = 1; k < 17; k++) {
-        uint16_t min_val = min_code[k];
-        uint16_t max_val = maj_code[k];
-        for(int i = 0; i < (1 << k); i++) {
-            if(i <= max_val && i >= min_val) {
-                uint16_t size_val = v[(k << 8) + i - min_val];
-                int run = size_val >> 4;
-                int size = size_val & 0xf;
-                mAcTable[n].run = run;
-                mAcTable[n].size = size;
-                mAcTable[n].len = k;
-                mAcTable[n].mask = (1 << k) - 1;
-                mAcTable[n].code = i;
-                n++;
+constexpr std::array<AcFastEntry, 1 << AC_FAST_BITS> makeAcFastLookup() {
+    std::array<AcFastEntry, 1 << AC_FAST_BITS> lookup{};
+    for(const AcCode& ac : AC_CODES) {
+        int len = ac.len + ac.size;
+        if(len > AC_FAST_BITS || (ac.size == 0 && ac.run != 0 && ac.run != 15)) {
+            continue;
+        }
+        uint32_t first = ac.code << (AC_FAST_BITS - ac.len);
+        for(uint32_t i = 0; i < (1u << (AC_FAST_BITS - ac.len)); i++) {
+            AcFastEntry& entry = lookup[first + i];
+            if(ac.size == 0) {
+                entry.run = ac.run == 0 ? AC_FAST_EOB : 15;
+                entry.value = 0;
+            } else {
+                entry.run = ac.run;
+                entry.value = static_cast<int16_t>(mapRange(ac.size, i >> (AC_FAST_BITS - len)));
             }
+            entry.len = static_cast<uint8_t>(len);
         }
     }
+    return lookup;
+}
 
-    for(int i = 0; i < 65536; i++) {
-        mAcLookup[i] = getAcReal(i);
-    }
-    for(int i = 0; i < 65536; i++) {
-        mDcLookup[i] = getDcReal(i);
+// (len << 8) | (run << 4) | size of the codes up to AC_FAST_BITS long, indexed by the next AC_FAST_BITS bits
+constexpr std::array<uint16_t, 1 << AC_FAST_BITS> makeAcCodeLookup() {
+    std::array<uint16_t, 1 << AC_FAST_BITS> lookup{};
+    for(const AcCode& ac : AC_CODES) {
+        if(ac.len > AC_FAST_BITS) {
+            continue;
+        }
+        uint32_t first = ac.code << (AC_FAST_BITS - ac.len);
+        for(uint32_t i = 0; i < (1u << (AC_FAST_BITS - ac.len)); i++) {
+            lookup[first + i] = static_cast<uint16_t>((ac.len << 8) | (ac.run << 4) | ac.size);
+        }
     }
+    return lookup;
 }
 
-int MeteorImage::getDcReal(uint16_t word) {
-    switch(word >> 14) {
-        case 0:
-            return 0;
-        default:
-            switch(word >> 13) {
-                case 2:
-                    return 1;
-                case 3:
-                    return 2;
-                case 4:
-                    return 3;
-                case 5:
-                    return 4;
-                case 6:
-                    return 5;
-                default:
-                    if((word >> 12) == 0x00e)
-                        return 6;
-                    if((word >> 11) == 0x01e)
-                        return 7;
-                    if((word >> 10) == 0x03e)
-                        return 8;
-                    if((word >> 9) == 0x07e)
-                        return 9;
-                    if((word >> 8) == 0x0fe)
-                        return 10;
-                    if((word >> 7) == 0x1fe)
-                        return 11;
-            }
+// The longer codes are the numerically largest ones, they all start at or above this AC_FAST_BITS bit prefix
+constexpr uint32_t acLongPrefix() {
+    uint32_t prefix = 1 << AC_FAST_BITS;
+    for(const AcCode& ac : AC_CODES) {
+        if(ac.len > AC_FAST_BITS) {
+            prefix = std::min<uint32_t>(prefix, ac.code >> (ac.len - AC_FAST_BITS));
+        }
     }
-    return -1;
+    return prefix;
 }
 
-int MeteorImage::getAcReal(uint16_t word) {
-    for(int i = 0; i < 162; i++) {
-        if(((word >> (16 - mAcTable[i].len)) & mAcTable[i].mask) == mAcTable[i].code) {
-            return i;
+constexpr uint32_t AC_LONG_PREFIX = acLongPrefix();
+
+// Same entries as AC_CODE_LOOKUP for the longer codes, indexed by the next 16 bits minus AC_LONG_PREFIX << 4
+constexpr std::array<uint16_t, ((1 << AC_FAST_BITS) - AC_LONG_PREFIX) << (16 - AC_FAST_BITS)> makeAcLongLookup() {
+    std::array<uint16_t, ((1 << AC_FAST_BITS) - AC_LONG_PREFIX) << (16 - AC_FAST_BITS)> lookup{};
+    for(const AcCode& ac : AC_CODES) {
+        if(ac.len <= AC_FAST_BITS) {
+            continue;
+        }
+        uint32_t first = (ac.code << (16 - ac.len)) - (AC_LONG_PREFIX << (16 - AC_FAST_BITS));
+        for(uint32_t i = 0; i < (1u << (16 - ac.len)); i++) {
+            lookup[first + i] = static_cast<uint16_t>((ac.len << 8) | (ac.run << 4) | ac.size);
         }
     }
-    return -1;
+    return lookup;
 }
 
-MeteorImage::~MeteorImage() {}
+constexpr std::array<uint8_t, 1 << DC_LOOKUP_BITS> DC_LOOKUP = makeDcLookup();
+constexpr std::array<AcFastEntry, 1 << AC_FAST_BITS> AC_FAST_LOOKUP = makeAcFastLookup();
+constexpr std::array<uint16_t, 1 << AC_FAST_BITS> AC_CODE_LOOKUP = makeAcCodeLookup();
+constexpr auto AC_LONG_LOOKUP = makeAcLongLookup();
 
-cv::Mat MeteorImage::getChannelImage(ChannelIDs APID, bool fillBlackLines) {
-    if(mFullImage.size() == 0) {
-        return cv::Mat();
+MeteorImage::MeteorImage()
+    : mChannelAvailable{}
+    , mLastMCU(-1)
+    , mCurY(0)
+    , mLastY(-1)
+    , mFirstPacket(0)
+    , mPrevPacket(0)
+    , mIntegerIdct(false)
+    , mThreadPool(nullptr)
+    , mMcuBatch(std::make_shared<McuBatch>()) {
+    for(auto& decodedMCUs : mDecodedMCUs) {
+        decodedMCUs = 0;
     }
+}
 
-    const int width = 8 * MCU_PER_LINE;
-    const int height = mCurY + 8;
+MeteorImage::~MeteorImage() {
+    waitForMCUs();
+}
 
-    cv::Mat image = cv::Mat(height, width, CV_8UC3);
+void MeteorImage::setDecodeThreadPool(ThreadPool* threadPool) {
+    waitForMCUs();
+    mThreadPool = threadPool;
+}
 
-    for(int y = 0; y < image.rows; y++) {
-        for(int x = 0; x < image.cols; x++) {
-            uint off = x + y * MCU_PER_LINE * 8;
+void MeteorImage::setRequestedChannels(const std::list<int>& apids) {
+    for(int apd = FIRST_APID; apd < FIRST_APID + CHANNEL_COUNT; apd++) {
+        mChannels[apd - FIRST_APID].deferred = !apids.empty() && std::find(apids.begin(), apids.end(), apd) == apids.end();
+        decodeDeferred(apd);
+    }
+}
 
-            cv::Vec3b& color = image.at<cv::Vec3b>(y, x);
+void MeteorImage::waitForMCUs() {
+    if(mThreadPool == nullptr) {
+        return;
+    }
 
-            image.at<cv::Vec3b>(cv::Point(x, y)) = color;
+    submitMCUs();
+    mMcuJobs.wait();
+}
 
-            switch(APID) {
-                case APID_68:
-                    color[0] = mFullImage[off].r;
-                    color[1] = mFullImage[off].r;
-                    color[2] = mFullImage[off].r;
-                    break;
-                case APID_66:
-                    color[0] = mFullImage[off].r;
-                    color[1] = mFullImage[off].r;
-                    color[2] = mFullImage[off].r;
-                    break;
-                case APID_65:
-                    color[0] = mFullImage[off].g;
-                    color[1] = mFullImage[off].g;
-                    color[2] = mFullImage[off].g;
-                    break;
-                case APID_64:
-                    color[0] = mFullImage[off].b;
-                    color[1] = mFullImage[off].b;
-                    color[2] = mFullImage[off].b;
-                    break;
-            }
+void MeteorImage::submitMCUs() {
+    if(mMcuBatch->jobs.empty()) {
+        return;
+    }
 
-            image.at<cv::Vec3b>(cv::Point(x, y)) = color;
+    std::shared_ptr<McuBatch> batch = mMcuBatch;
+    mThreadPool->addJob([this, batch]() {
+        for(const McuJob& job : batch->jobs) {
+            mDecodedMCUs[job.apd - FIRST_APID] += decodeMCUs(&batch->payload[job.offset], job.length, job.mcuId, *job.dqt, job.row);
         }
+    }, mMcuJobs);
+    mMcuBatch = std::make_shared<McuBatch>();
+}
+
+cv::Mat MeteorImage::getChannelPlane(ChannelIDs APID) {
+    if(APID < FIRST_APID || APID >= FIRST_APID + CHANNEL_COUNT) {
+        return cv::Mat();
     }
 
+    decodeDeferred(APID);
+    waitForMCUs();
 
-    if(fillBlackLines) {
-        ThreatImage::fillBlackLines(image, 8, 64);
+    if(mLastMCU == -1) {
+        return cv::Mat();
     }
 
-    return image;
+    const size_t width = 8 * MCU_PER_LINE;
+    const int height = mCurY + 8;
+
+    Channel& channel = mChannels[APID - FIRST_APID];
+    if(!channel.planeValid || channel.plane.size() != width * height) {
+        // Channels which ended earlier or never started are black at the bottom
+        channel.plane.assign(width * height, 0);
+
+        const size_t stripSize = width * STRIP_LINES;
+        for(size_t i = 0; i < channel.strips.size() && i * stripSize < channel.plane.size(); i++) {
+            const size_t offset = i * stripSize;
+            std::copy(channel.strips[i].begin(), channel.strips[i].begin() + std::min(stripSize, channel.plane.size() - offset), channel.plane.begin() + offset);
+        }
+        channel.planeValid = true;
+    }
+
+    return cv::Mat(height, width, CV_8UC1, channel.plane.data());
 }
 
-cv::Mat MeteorImage::getRGBImage(ChannelIDs redAPID, ChannelIDs greenAPID, ChannelIDs blueAPID, bool fillBlackLines) {
-    if(mFullImage.size() == 0) {
+cv::Mat MeteorImage::getChannelImage(ChannelIDs APID, bool fillBlackLines) {
+    cv::Mat plane = getChannelPlane(APID);
+    if(plane.empty()) {
         return cv::Mat();
     }
 
-    int width = 8 * MCU_PER_LINE;
-    int height = mCurY + 8;
-    cv::Mat image = cv::Mat(height, width, CV_8UC3);
-    cv::Vec3b color;
+    cv::Mat image;
+    cv::merge(std::vector<cv::Mat>{plane, plane, plane}, image);
 
-    for(int y = 0; y < image.rows; y++) {
-        for(int x = 0; x < image.cols; x++) {
-            uint off = x + y * MCU_PER_LINE * 8;
+    if(fillBlackLines) {
+        ThreatImage::fillBlackLines(image, 8, 64);
+    }
 
-            color[0] = (blueAPID == APID_66 || blueAPID == APID_68) ? mFullImage[off].r : (blueAPID == APID_65) ? mFullImage[off].g : mFullImage[off].b;
-            color[1] = (greenAPID == APID_66 || greenAPID == APID_68) ? mFullImage[off].r : (greenAPID == APID_65) ? mFullImage[off].g : mFullImage[off].b;
-            color[2] = (redAPID == APID_66 || redAPID == APID_68) ? mFullImage[off].r : (redAPID == APID_65) ? mFullImage[off].g : mFullImage[off].b;
-            image.at<cv::Vec3b>(cv::Point(x, y)) = color;
-        }
+    return image;
+}
+
+cv::Mat MeteorImage::getRGBImage(ChannelIDs redAPID, ChannelIDs greenAPID, ChannelIDs blueAPID, bool fillBlackLines) {
+    cv::Mat blue = getChannelPlane(blueAPID);
+    cv::Mat green = getChannelPlane(greenAPID);
+    cv::Mat red = getChannelPlane(redAPID);
+    if(blue.empty() || green.empty() || red.empty()) {
+        return cv::Mat();
     }
 
+    cv::Mat image;
+    cv::merge(std::vector<cv::Mat>{blue, green, red}, image);
 
     if(fillBlackLines) {
         ThreatImage::fillBlackLines(image, 8, 64);
@@ -244,7 +292,7 @@ bool MeteorImage::progressImage(int apd, int mcu_id, int pck_cnt) {
         mFirstPacket = pck_cnt;
         if(apd == 65)
             mFirstPacket -= 14;
-        if(apd == 66)
+        if(apd == 66 || apd == 67)
             mFirstPacket -= 28;
         if(apd == 68)
             mFirstPacket -= 28;
@@ -257,9 +305,6 @@ bool MeteorImage::progressImage(int apd, int mcu_id, int pck_cnt) {
     mPrevPacket = pck_cnt;
 
     mCurY = 8 * ((pck_cnt - mFirstPacket) / (14 + 14 + 14 + 1));
-    if(mCurY > mLastY) {
-        mFullImage.resize(MCU_PER_LINE * 8 * (mCurY + 8));
-    }
     mLastY = mCurY;
 
     return true;
@@ -279,132 +324,182 @@ void MeteorImage::fillDqtByQ(std::array<int, 64>& dqt, int q) {
     }
 }
 
-int MeteorImage::mapRange(int cat, int vl) {
-    int maxval = (1 << cat) - 1;
-    bool sig = (vl >> (cat - 1)) != 0;
-    if(sig)
-        return vl;
-    else
-        return vl - maxval;
-}
-
-void MeteorImage::filtIdct8x8(std::array<float, 64>& res, std::array<float, 64>& inp) {
-    for(int y = 0; y < 8; y++) {
-        for(int x = 0; x < 8; x++) {
-            float s = 0;
-            for(int u = 0; u < 8; u++) {
-                float cxu = mAlpha[u] * mCosine[x][u];
-                s += cxu
-                     * (inp[0 * 8 + u] * mAlpha[0] * mCosine[y][0] + inp[1 * 8 + u] * mAlpha[1] * mCosine[y][1] + inp[2 * 8 + u] * mAlpha[2] * mCosine[y][2] + inp[3 * 8 + u] * mAlpha[3] * mCosine[y][3]
-                        + inp[4 * 8 + u] * mAlpha[4] * mCosine[y][4] + inp[5 * 8 + u] * mAlpha[5] * mCosine[y][5] + inp[6 * 8 + u] * mAlpha[6] * mCosine[y][6] + inp[7 * 8 + u] * mAlpha[7] * mCosine[y][7]);
-            }
-            res[y * 8 + x] = s / 4;
-        }
+const MeteorImage::Dqt& MeteorImage::getDqt(int q) {
+    auto it = mDqtTables.find(q);
+    if(it != mDqtTables.end()) {
+        return it->second;
     }
-}
 
-void MeteorImage::fillPix(std::array<float, 64>& img_dct, int apd, int mcu_id, int m) {
-    for(int i = 0; i < 64; i++) {
-        int t = round(img_dct[i] + 128);
-        if(t < 0)
-            t = 0;
-        if(t > 255)
-            t = 255;
-        int x = (mcu_id + m) * 8 + i % 8;
-        int y = mCurY + i / 8;
-        uint off = x + y * MCU_PER_LINE * 8;
-
-        if(apd == APID_68 || apd == APID_66) {
-            mFullImage[off].r = t;
-        }
-        if(apd == APID_65) {
-            mFullImage[off].g = t;
-        }
-        if(apd == APID_64) {
-            mFullImage[off].b = t;
-        }
-    }
+    std::array<int, 64> dqt;
+    fillDqtByQ(dqt, q);
+
+    Dqt& scaled = mDqtTables[q];
+    Idct8x8::scaleFloat(dqt, scaled.scaledFloat);
+    Idct8x8::scaleInt16(dqt, scaled.scaledInt16);
+    return scaled;
 }
 
 void MeteorImage::decMCUs(const uint8_t* packet, int len, int apd, int pck_cnt, int mcu_id, uint8_t q) {
-    BitIOConst b(packet);
-
     if(!progressImage(apd, mcu_id, pck_cnt))
         return;
 
-    if(apd == APID_64) {
-        mIsChannel64Available = true;
+    if(apd < FIRST_APID || apd >= FIRST_APID + CHANNEL_COUNT) {
+        return;
     }
-    if(apd == APID_65) {
-        mIsChannel65Available = true;
+    mChannelAvailable[apd - FIRST_APID] = true;
+
+    if(mCurY < 0) {
+        return;
     }
 
-    if(apd == APID_66) {
-        mIsChannel66Available = true;
+    Channel& channel = mChannels[apd - FIRST_APID];
+    if(channel.deferred) {
+        channel.packets.push_back({mCurY, mcu_id, q, channel.payload.size(), len});
+        channel.payload.insert(channel.payload.end(), packet, packet + len);
+        return;
     }
-    if(apd == APID_68) {
-        mIsChannel68Available = true;
+
+    placeMCUs(packet, len, apd, mCurY, mcu_id, q);
+}
+
+void MeteorImage::decodeDeferred(int apd) {
+    Channel& channel = mChannels[apd - FIRST_APID];
+    for(const DeferredPacket& packet : channel.packets) {
+        placeMCUs(&channel.payload[packet.offset], packet.length, apd, packet.y, packet.mcuId, packet.q);
     }
 
-    std::array<int, 64> dqt{};
-    std::array<float, 64> zdct{}, dct{}, img_dct{};
-    fillDqtByQ(dqt, q);
+    // Queued jobs hold their own copy of the payload
+    channel.packets.clear();
+    channel.payload.clear();
+}
+
+void MeteorImage::placeMCUs(const uint8_t* packet, int len, int apd, int y, int mcu_id, uint8_t q) {
+    // Only the row allocation has to be in stream order, the MCUs of different packets are independent
+    const size_t width = MCU_PER_LINE * 8;
+    Channel& channel = mChannels[apd - FIRST_APID];
+    const size_t strip = y / STRIP_LINES;
+    while(channel.strips.size() <= strip) {
+        channel.strips.emplace_back(width * STRIP_LINES);
+    }
+    channel.planeValid = false;
+
+    uint8_t* row = &channel.strips[strip][(y % STRIP_LINES) * width];
+    const Dqt& dqt = getDqt(q);
+
+    if(mThreadPool == nullptr) {
+        mDecodedMCUs[apd - FIRST_APID] += decodeMCUs(packet, len, mcu_id, dqt, row);
+        return;
+    }
+
+    McuBatch& batch = *mMcuBatch;
+    batch.jobs.push_back({apd, mcu_id, &dqt, row, batch.payload.size(), len});
+    batch.payload.insert(batch.payload.end(), packet, packet + len);
+    if(batch.jobs.size() >= PACKETS_PER_JOB) {
+        submitMCUs();
+    }
+}
+
+int MeteorImage::decodeMCUs(const uint8_t* packet, int len, int mcu_id, const Dqt& dqt, uint8_t* row) const {
+    const size_t width = MCU_PER_LINE * 8;
+    BitIOConst b(packet, len);
+
+    // Quantized coefficients in natural order
+    std::array<int, 64> coefficients;
+    std::array<uint8_t, 64> pixels;
 
-    float prev_dc = 0;
+    int prev_dc = 0;
     int m = 0;
     while(m < MCU_PER_PACKET) {
-        int dc_cat = mDcLookup[b.peekBits(16)];
-        if(dc_cat == -1) {
+        uint8_t dc = DC_LOOKUP[b.peekBits(DC_LOOKUP_BITS)];
+        if(dc == 0) {
             std::cerr << "Bad DC Huffman code!" << std::endl;
-            return;
+            return m;
         }
-        b.advanceBits(DC_CAT_OFF[dc_cat]);
+        int dc_cat = dc & 0xf;
+        b.advanceBits(dc >> 4);
         uint32_t n = b.fetchBits(dc_cat);
 
-        zdct[0] = mapRange(dc_cat, n) + prev_dc;
-        prev_dc = zdct[0];
+        coefficients.fill(0);
+        coefficients[0] = mapRange(dc_cat, n) + prev_dc;
+        prev_dc = coefficients[0];
 
+        // Zero runs only advance k, the block is already cleared
         int k = 1;
         while(k < 64) {
-            int ac = mAcLookup[b.peekBits(16)];
-            if(ac == -1) {
+            // Short codes together with their value bits, ZRL and EOB
+            const AcFastEntry& fast = AC_FAST_LOOKUP[b.peekBits(AC_FAST_BITS)];
+            if(fast.len != 0) {
+                b.advanceBits(fast.len);
+                if(fast.run == AC_FAST_EOB) {
+                    break;
+                }
+                k += fast.run;
+                if(k > 63) {
+                    break;
+                }
+                coefficients[NATURAL_ORDER[k]] = fast.value;
+                k++;
+                continue;
+            }
+
+            uint16_t ac = AC_CODE_LOOKUP[b.peekBits(AC_FAST_BITS)];
+            if(ac == 0) {
+                uint32_t word = b.peekBits(16);
+                if((word >> (16 - AC_FAST_BITS)) >= AC_LONG_PREFIX) {
+                    ac = AC_LONG_LOOKUP[word - (AC_LONG_PREFIX << (16 - AC_FAST_BITS))];
+                }
+            }
+            if(ac == 0) {
                 std::cerr << "Bad AC Huffman code!" << std::endl;
-                return;
+                return m;
             }
-            int ac_len = mAcTable[ac].len;
-            int ac_size = mAcTable[ac].size;
-            int ac_run = mAcTable[ac].run;
+            int ac_len = ac >> 8;
+            int ac_size = ac & 0xf;
+            int ac_run = (ac >> 4) & 0xf;
             b.advanceBits(ac_len);
 
             if(ac_run == 0 && ac_size == 0) {
-                for(int i = k; i < 64; i++) {
-                    zdct[i] = 0;
-                }
                 break;
             }
 
-            for(int i = 0; i < ac_run; i++) {
-                zdct[k] = 0;
-                k++;
+            k += ac_run;
+            if(k > 63) {
+                break;
             }
 
             if(ac_size != 0) {
                 uint16_t n = b.fetchBits(ac_size);
-                zdct[k] = mapRange(ac_size, n);
+                coefficients[NATURAL_ORDER[k]] = mapRange(ac_size, n);
                 k++;
             } else if(ac_run == 15) {
-                zdct[k] = 0;
                 k++;
             }
         }
 
-        for(int i = 0; i < 64; i++) {
-            dct[i] = zdct[ZIGZAG[i]] * dqt[i];
+        if(mIntegerIdct) {
+            std::array<int16_t, 64> block;
+            for(int i = 0; i < 64; i++) {
+                int64_t value = (static_cast<int64_t>(coefficients[i]) * dqt.scaledInt16[i] + (1 << (Idct8x8::INT16_TABLE_BITS - 1))) >> Idct8x8::INT16_TABLE_BITS;
+                block[i] = static_cast<int16_t>(std::clamp<int64_t>(value, INT16_MIN, INT16_MAX));
+            }
+            Idct8x8::idctInt16(block.data(), pixels.data());
+        } else {
+            std::array<float, 64> block;
+            for(int i = 0; i < 64; i++) {
+                block[i] = coefficients[i] * dqt.scaledFloat[i];
+            }
+            Idct8x8::idctFloat(block.data(), pixels.data());
         }
 
-        filtIdct8x8(img_dct, dct);
-        fillPix(img_dct, apd, mcu_id, m);
+        if(mcu_id + m < static_cast<int>(MCU_PER_LINE)) {
+            uint8_t* dst = &row[(mcu_id + m) * 8];
+            for(int y = 0; y < 8; y++) {
+                std::copy(&pixels[y * 8], &pixels[y * 8 + 8], &dst[y * width]);
+            }
+        }
 
         m++;
     }
+
+    return m;
 }
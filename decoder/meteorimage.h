@@ -2,45 +2,25 @@
 #define METEORIMAGE_H
 
 #include <array>
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <vector>
 
+#include "threadpool.h"
 #include "threatimage.h"
 
 // Based on: https://github.com/artlav/meteor_decoder/blob/master/met_jpg.pas
 
 
-#ifdef __GNUC__
-#define PACK(__Declaration__) __Declaration__ __attribute__((__packed__))
-#endif
-
-#ifdef _MSC_VER
-#define PACK(__Declaration__) __pragma(pack(push, 1)) __Declaration__ __pragma(pack(pop))
-#endif
-
-union Pixel {
-    PACK(struct {
-        uint8_t b;
-        uint8_t g;
-        uint8_t r;
-        uint8_t a;
-    });
-    uint32_t pixel;
-};
-
-struct ac_table_rec {
-    int run;
-    int size;
-    int len;
-    uint32_t mask;
-    uint32_t code;
-};
-
 class MeteorImage {
   public:
     enum ChannelIDs {
         APID_68 = 68, // R
+        APID_67 = 67, // R
         APID_66 = 66, // B
         APID_65 = 65, // G
         APID_64 = 64  // R
@@ -53,23 +33,55 @@ class MeteorImage {
     cv::Mat getRGBImage(ChannelIDs redAPID, ChannelIDs greenAPID, ChannelIDs blueAPID, bool fillBlackLines = true);
     cv::Mat getChannelImage(ChannelIDs APID, bool fillBlackLines = true);
 
+    // Single channel CV_8UC1 header over the decoded plane, valid until the next decoded packet, empty for an unknown APID.
+    // The strips are joined into the contiguous plane only when it is out of date, modifying it does not change the decoded strips
+    cv::Mat getChannelPlane(ChannelIDs APID);
+
   public:
+    bool isChannelAvailable(ChannelIDs APID) const {
+        return mChannelAvailable[APID - FIRST_APID];
+    }
     bool isChannel64Available() const {
-        return mIsChannel64Available;
+        return isChannelAvailable(APID_64);
     }
     bool isChannel65Available() const {
-        return mIsChannel65Available;
+        return isChannelAvailable(APID_65);
     }
     bool isChannel66Available() const {
-        return mIsChannel66Available;
+        return isChannelAvailable(APID_66);
+    }
+    bool isChannel67Available() const {
+        return isChannelAvailable(APID_67);
     }
     bool isChannel68Available() const {
-        return mIsChannel68Available;
+        return isChannelAvailable(APID_68);
     }
 
+    // Use the 16 bit fixed point IDCT instead of the float one
+    void setIntegerIdct(bool integerIdct) {
+        waitForMCUs();
+        mIntegerIdct = integerIdct;
+    }
+
+    // Packets are placed into the image in stream order on the caller's thread and their MCUs are decoded on the pool, nullptr decodes on the caller's thread
+    void setDecodeThreadPool(ThreadPool* threadPool);
+
+    // Waits until every queued packet is decoded, the image getters wait on their own
+    void waitForMCUs();
+
+    // Only the listed APIDs are decoded while the packets are parsed, packets of the other channels are stored and decoded
+    // when the channel is first requested. An empty list decodes every channel right away
+    void setRequestedChannels(const std::list<int>& apids);
+
   protected:
+    // Decodes the MCUs of the packet or queues them on the decode thread pool
     void decMCUs(const uint8_t* packet, int len, int apd, int pck_cnt, int mcu_id, uint8_t q);
 
+    // MCUs of the APID decoded since the last call
+    int takeDecodedMCUs(int apd) {
+        return mDecodedMCUs[apd - FIRST_APID].exchange(0);
+    }
+
     int getLastY() const {
         return mLastY;
     }
@@ -79,28 +91,83 @@ class MeteorImage {
     }
 
   private:
-    void initHuffmanTable();
-    void initCos();
-    int getDcReal(uint16_t word);
-    int getAcReal(uint16_t word);
     bool progressImage(int apd, int mcuID, int pckCnt);
     void fillDqtByQ(std::array<int, 64>& dqt, int q);
-    int mapRange(int cat, int vl);
-    void filtIdct8x8(std::array<float, 64>& res, std::array<float, 64>& inp);
-    void fillPix(std::array<float, 64>& imgDct, int apd, int mcu_id, int m);
+
+  protected:
+    static constexpr int FIRST_APID = APID_64;
+    static constexpr int CHANNEL_COUNT = APID_68 - APID_64 + 1;
 
   private:
-    bool mIsChannel64Available;
-    bool mIsChannel65Available;
-    bool mIsChannel66Available;
-    bool mIsChannel68Available;
+    static constexpr int STRIP_LINES = 8 * 16;
+    static constexpr size_t PACKETS_PER_JOB = 32;
 
-    std::vector<Pixel> mFullImage;
+    // Dequantization tables with the IDCT scale factors
+    struct Dqt {
+        std::array<float, 64> scaledFloat;
+        std::array<int32_t, 64> scaledInt16;
+    };
+
+    // Packet of a decode job, row is the first pixel of its MCU row in the channel strip
+    struct McuJob {
+        int apd;
+        int mcuId;
+        const Dqt* dqt;
+        uint8_t* row;
+        size_t offset;
+        int length;
+    };
+
+    struct McuBatch {
+        std::vector<McuJob> jobs;
+        std::vector<uint8_t> payload;
+    };
+
+    // Image row resolved from the packet counter, the payload is at offset in the channel
+    struct DeferredPacket {
+        int y;
+        int mcuId;
+        uint8_t q;
+        size_t offset;
+        int length;
+    };
+
+    struct Channel {
+        // STRIP_LINES rows each, MCU_PER_LINE * 8 pixels wide, the image grows by a strip without moving the decoded rows
+        std::vector<std::vector<uint8_t>> strips;
+
+        // Contiguous copy of the strips for OpenCV
+        std::vector<uint8_t> plane;
+        bool planeValid = false;
+
+        // Packets waiting for the channel to be requested
+        bool deferred = false;
+        std::vector<DeferredPacket> packets;
+        std::vector<uint8_t> payload;
+    };
+
+    std::array<Channel, CHANNEL_COUNT> mChannels;
+    std::array<bool, CHANNEL_COUNT> mChannelAvailable;
     int mLastMCU, mCurY, mLastY, mFirstPacket, mPrevPacket;
-    std::array<int, 65536> mAcLookup{}, mDcLookup{};
-    std::array<ac_table_rec, 162> mAcTable{};
-    std::array<std::array<float, 8>, 8> mCosine{};
-    std::array<float, 8> mAlpha;
+    bool mIntegerIdct;
+
+    // One entry per quality factor, the entries are read by the decode jobs and never move
+    std::map<int, Dqt> mDqtTables;
+
+    ThreadPool* mThreadPool;
+    // Only the jobs of this image are waited for, the pool is shared with the frame decoder
+    ThreadPool::JobCounter mMcuJobs;
+    std::shared_ptr<McuBatch> mMcuBatch;
+    std::array<std::atomic<int>, CHANNEL_COUNT> mDecodedMCUs;
+
+  private:
+    const Dqt& getDqt(int q);
+    void placeMCUs(const uint8_t* packet, int len, int apd, int y, int mcu_id, uint8_t q);
+    void decodeDeferred(int apd);
+    void submitMCUs();
+
+    // Thread safe, writes the MCUs into the row of the channel strip
+    int decodeMCUs(const uint8_t* packet, int len, int mcu_id, const Dqt& dqt, uint8_t* row) const;
 };
 
 #endif // METEORIMAGE_H
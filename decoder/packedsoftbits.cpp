@@ -0,0 +1,394 @@
+#include "packedsoftbits.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__) && !defined(__SSE2__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+// A soft bit v is quantized to the level ((2 * v * multiplier) >> 16) + levels / 2, multiplier = levels * 16384 / scale.
+// The scale never goes below levels / 2, so a step is at least one input unit and the multiplier fits into 16 bits.
+// The sign of the soft bit is always kept, every level is reconstructed to the middle of its interval.
+
+namespace {
+
+inline uint8_t magnitude(uint8_t softBit) {
+    // Ones' complement magnitude, the SIMD kernels compute the same without an abs instruction
+    const int8_t value = static_cast<int8_t>(softBit);
+    return static_cast<uint8_t>(value ^ (value >> 7));
+}
+
+inline uint8_t quantize(uint8_t softBit, int16_t multiplier, uint8_t levels) {
+    const int32_t level = ((2 * static_cast<int8_t>(softBit) * multiplier) >> 16) + levels / 2;
+    return static_cast<uint8_t>(std::clamp<int32_t>(level, 0, levels - 1));
+}
+
+void reconstructionTable(int bits, int scale, uint8_t* table) {
+    const int levels = 1 << bits;
+
+    for(int level = 0; level < levels; level++) {
+        const int k = 2 * level - levels + 1;
+        const int value = std::clamp((std::abs(k) * scale + levels / 2) / levels, 1, 127);
+        table[level] = static_cast<uint8_t>(static_cast<int8_t>(k > 0 ? value : -value));
+    }
+}
+
+} // namespace
+
+const PackedSoftBits::Kernels PackedSoftBits::sKernels;
+
+PackedSoftBits::Kernels::Kernels()
+    : maxMagnitude(maxMagnitudeScalar)
+    , quantize(quantizeScalar)
+    , unpack4(unpack4Scalar) {
+#if defined(CPU_FEATURES_X86)
+    if(CpuFeatures::hasSSE2()) {
+        maxMagnitude = maxMagnitudeSSE2;
+        quantize = quantizeSSE2;
+    }
+    if(CpuFeatures::hasSSSE3()) {
+        unpack4 = unpack4SSSE3;
+    }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+    maxMagnitude = maxMagnitudeNEON;
+    quantize = quantizeNEON;
+    unpack4 = unpack4NEON;
+#endif
+}
+
+PackedSoftBits::Writer::Writer(std::ostream& stream, int bits, bool adaptiveScale)
+    : mStream(stream)
+    , mBits(std::clamp(bits, MIN_BITS, MAX_BITS))
+    , mAdaptiveScale(adaptiveScale)
+    , mLength(0)
+    , mHeaderPos(stream.tellp()) {
+    mBlock.reserve(BLOCK_SIZE);
+    mPacked.resize(packedBlockSize(BLOCK_SIZE, mBits));
+
+    // The length is filled in by finish()
+    Header header = {MAGIC, VERSION, static_cast<uint8_t>(mBits), static_cast<uint8_t>(mAdaptiveScale), 0, BLOCK_SIZE, 0};
+    mStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void PackedSoftBits::Writer::write(const uint8_t* softBits, size_t length) {
+    while(length > 0) {
+        if(mBlock.empty() && length >= BLOCK_SIZE) {
+            writeBlock(softBits, BLOCK_SIZE);
+            softBits += BLOCK_SIZE;
+            length -= BLOCK_SIZE;
+            continue;
+        }
+
+        const size_t count = std::min<size_t>(BLOCK_SIZE - mBlock.size(), length);
+        mBlock.insert(mBlock.end(), softBits, softBits + count);
+        softBits += count;
+        length -= count;
+
+        if(mBlock.size() == BLOCK_SIZE) {
+            writeBlock(mBlock.data(), mBlock.size());
+            mBlock.clear();
+        }
+    }
+}
+
+void PackedSoftBits::Writer::finish() {
+    if(!mBlock.empty()) {
+        writeBlock(mBlock.data(), mBlock.size());
+        mBlock.clear();
+    }
+
+    const std::streampos end = mStream.tellp();
+    Header header = {MAGIC, VERSION, static_cast<uint8_t>(mBits), static_cast<uint8_t>(mAdaptiveScale), 0, BLOCK_SIZE, mLength};
+    mStream.seekp(mHeaderPos);
+    mStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    mStream.seekp(end);
+}
+
+void PackedSoftBits::Writer::writeBlock(const uint8_t* softBits, size_t length) {
+    const size_t size = packBlock(softBits, length, mBits, mAdaptiveScale, mPacked.data());
+    mStream.write(reinterpret_cast<const char*>(mPacked.data()), size);
+    mLength += length;
+}
+
+uint64_t PackedSoftBits::unpackedLength(const uint8_t* data, size_t size) {
+    Header header;
+    if(size < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+
+    if(header.magic != MAGIC || header.version != VERSION || header.bits < MIN_BITS || header.bits > MAX_BITS || header.blockSize != BLOCK_SIZE) {
+        return 0;
+    }
+
+    const uint64_t fullBlocks = header.length / BLOCK_SIZE;
+    const uint64_t lastBlock = header.length % BLOCK_SIZE;
+    const uint64_t packedSize = sizeof(header) + fullBlocks * packedBlockSize(BLOCK_SIZE, header.bits) + (lastBlock > 0 ? packedBlockSize(lastBlock, header.bits) : 0);
+
+    return packedSize <= size ? header.length : 0;
+}
+
+PackedSoftBits::Reader::Reader()
+    : mPacked(nullptr)
+    , mBits(0)
+    , mLength(0) {}
+
+bool PackedSoftBits::Reader::open(const uint8_t* data, size_t size) {
+    mLength = unpackedLength(data, size);
+    if(mLength == 0) {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, data, sizeof(header));
+
+    mPacked = data + sizeof(header);
+    mBits = header.bits;
+    return true;
+}
+
+void PackedSoftBits::Reader::read(uint64_t pos, size_t length, uint8_t* softBits) const {
+    // Every block but the last one is full, so a block is found by its index
+    const size_t packedSize = packedBlockSize(BLOCK_SIZE, mBits);
+    uint8_t block[BLOCK_SIZE];
+
+    while(length > 0) {
+        const uint64_t blockStart = pos / BLOCK_SIZE * BLOCK_SIZE;
+        const size_t blockLength = std::min<uint64_t>(BLOCK_SIZE, mLength - blockStart);
+        const size_t skip = pos - blockStart;
+        const size_t count = std::min(blockLength - skip, length);
+        const uint8_t* packed = mPacked + pos / BLOCK_SIZE * packedSize;
+
+        if(skip == 0 && count == blockLength) {
+            unpackBlock(packed, blockLength, mBits, softBits);
+        } else {
+            unpackBlock(packed, blockLength, mBits, block);
+            memcpy(softBits, &block[skip], count);
+        }
+
+        pos += count;
+        softBits += count;
+        length -= count;
+    }
+}
+
+size_t PackedSoftBits::packBlock(const uint8_t* softBits, size_t length, int bits, bool adaptiveScale, uint8_t* packed) {
+    const uint8_t levels = static_cast<uint8_t>(1 << bits);
+    const int scale = adaptiveScale ? std::max<int>(sKernels.maxMagnitude(softBits, length) + 1, levels / 2) : 128;
+    const int16_t multiplier = static_cast<int16_t>(std::min(32767, levels * 16384 / scale));
+
+    alignas(16) uint8_t quantized[BLOCK_SIZE + 8];
+    sKernels.quantize(softBits, length, multiplier, levels, quantized);
+    memset(&quantized[length], 0, 8);
+
+    packed[0] = static_cast<uint8_t>(scale);
+    uint8_t* out = packed + 1;
+
+    // Eight levels fill exactly 'bits' bytes, the first level is in the lowest bits
+    for(size_t i = 0; i < length; i += 8) {
+        uint64_t word = 0;
+        for(int n = 0; n < 8; n++) {
+            word |= static_cast<uint64_t>(quantized[i + n]) << (n * bits);
+        }
+        for(int n = 0; n < bits; n++) {
+            *out++ = static_cast<uint8_t>(word >> (n * 8));
+        }
+    }
+
+    return packedBlockSize(length, bits);
+}
+
+void PackedSoftBits::unpackBlock(const uint8_t* packed, size_t length, int bits, uint8_t* softBits) {
+    uint8_t table[1 << MAX_BITS];
+    reconstructionTable(bits, packed[0], table);
+    packed++;
+
+    if(bits == 4) {
+        sKernels.unpack4(packed, length, table, softBits);
+        return;
+    }
+
+    const uint64_t mask = (1 << bits) - 1;
+    for(size_t i = 0; i < length; i += 8) {
+        uint64_t word = 0;
+        for(int n = 0; n < bits; n++) {
+            word |= static_cast<uint64_t>(*packed++) << (n * 8);
+        }
+
+        const size_t count = std::min<size_t>(8, length - i);
+        for(size_t n = 0; n < count; n++) {
+            softBits[i + n] = table[(word >> (n * bits)) & mask];
+        }
+    }
+}
+
+uint8_t PackedSoftBits::maxMagnitudeScalar(const uint8_t* softBits, size_t length) {
+    uint8_t result = 0;
+    for(size_t i = 0; i < length; i++) {
+        result = std::max(result, magnitude(softBits[i]));
+    }
+    return result;
+}
+
+void PackedSoftBits::quantizeScalar(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized) {
+    for(size_t i = 0; i < length; i++) {
+        quantized[i] = quantize(softBits[i], multiplier, levels);
+    }
+}
+
+void PackedSoftBits::unpack4Scalar(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits) {
+    for(size_t i = 0; i < length; i++) {
+        const uint8_t byte = packed[i / 2];
+        softBits[i] = table[(i & 1) ? byte >> 4 : byte & 0x0F];
+    }
+}
+
+#if defined(CPU_FEATURES_X86)
+
+TARGET_SSE2 uint8_t PackedSoftBits::maxMagnitudeSSE2(const uint8_t* softBits, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i result = zero;
+    size_t i = 0;
+
+    for(; i + 16 <= length; i += 16) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&softBits[i]));
+        result = _mm_max_epu8(result, _mm_xor_si128(data, _mm_cmpgt_epi8(zero, data)));
+    }
+
+    alignas(16) uint8_t lanes[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), result);
+
+    return std::max(*std::max_element(lanes, lanes + 16), maxMagnitudeScalar(&softBits[i], length - i));
+}
+
+TARGET_SSE2 void PackedSoftBits::quantizeSSE2(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(multiplier);
+    const __m128i offset = _mm_set1_epi16(levels / 2);
+    const __m128i maxLevel = _mm_set1_epi8(static_cast<char>(levels - 1));
+    size_t i = 0;
+
+    for(; i + 16 <= length; i += 16) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&softBits[i]));
+        const __m128i sign = _mm_cmpgt_epi8(zero, data);
+        const __m128i low = _mm_add_epi16(_mm_mulhi_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(data, sign), 1), factor), offset);
+        const __m128i high = _mm_add_epi16(_mm_mulhi_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(data, sign), 1), factor), offset);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&quantized[i]), _mm_min_epu8(_mm_packus_epi16(low, high), maxLevel));
+    }
+
+    quantizeScalar(&softBits[i], length - i, multiplier, levels, &quantized[i]);
+}
+
+CPU_FEATURES_TARGET_SSSE3 void PackedSoftBits::unpack4SSSE3(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits) {
+    const __m128i lookup = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for(; i + 32 <= length; i += 32) {
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&packed[i / 2]));
+        const __m128i low = _mm_and_si128(data, lowNibble);
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(data, 4), lowNibble);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&softBits[i]), _mm_shuffle_epi8(lookup, _mm_unpacklo_epi8(low, high)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&softBits[i + 16]), _mm_shuffle_epi8(lookup, _mm_unpackhi_epi8(low, high)));
+    }
+
+    unpack4Scalar(&packed[i / 2], length - i, table, &softBits[i]);
+}
+
+#else
+
+uint8_t PackedSoftBits::maxMagnitudeSSE2(const uint8_t* softBits, size_t length) {
+    return maxMagnitudeScalar(softBits, length);
+}
+
+void PackedSoftBits::quantizeSSE2(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized) {
+    quantizeScalar(softBits, length, multiplier, levels, quantized);
+}
+
+void PackedSoftBits::unpack4SSSE3(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits) {
+    unpack4Scalar(packed, length, table, softBits);
+}
+
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+
+uint8_t PackedSoftBits::maxMagnitudeNEON(const uint8_t* softBits, size_t length) {
+    uint8x16_t result = vdupq_n_u8(0);
+    size_t i = 0;
+
+    for(; i + 16 <= length; i += 16) {
+        const int8x16_t data = vreinterpretq_s8_u8(vld1q_u8(&softBits[i]));
+        result = vmaxq_u8(result, vreinterpretq_u8_s8(veorq_s8(data, vshrq_n_s8(data, 7))));
+    }
+
+    return std::max(vmaxvq_u8(result), maxMagnitudeScalar(&softBits[i], length - i));
+}
+
+void PackedSoftBits::quantizeNEON(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized) {
+    const int16x8_t factor = vdupq_n_s16(multiplier);
+    const int16x8_t offset = vdupq_n_s16(levels / 2);
+    const uint8x16_t maxLevel = vdupq_n_u8(levels - 1);
+    size_t i = 0;
+
+    for(; i + 16 <= length; i += 16) {
+        const int8x16_t data = vreinterpretq_s8_u8(vld1q_u8(&softBits[i]));
+        // vqdmulh is (2 * a * b) >> 16, the same rounding as the SSE2 kernel
+        const int16x8_t low = vaddq_s16(vqdmulhq_s16(vmovl_s8(vget_low_s8(data)), factor), offset);
+        const int16x8_t high = vaddq_s16(vqdmulhq_s16(vmovl_s8(vget_high_s8(data)), factor), offset);
+
+        vst1q_u8(&quantized[i], vminq_u8(vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)), maxLevel));
+    }
+
+    quantizeScalar(&softBits[i], length - i, multiplier, levels, &quantized[i]);
+}
+
+void PackedSoftBits::unpack4NEON(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits) {
+    const uint8x16_t lookup = vld1q_u8(table);
+    const uint8x16_t lowNibble = vdupq_n_u8(0x0F);
+    size_t i = 0;
+
+    for(; i + 32 <= length; i += 32) {
+        const uint8x16_t data = vld1q_u8(&packed[i / 2]);
+        const uint8x16_t low = vandq_u8(data, lowNibble);
+        const uint8x16_t high = vshrq_n_u8(data, 4);
+
+        vst1q_u8(&softBits[i], vqtbl1q_u8(lookup, vzip1q_u8(low, high)));
+        vst1q_u8(&softBits[i + 16], vqtbl1q_u8(lookup, vzip2q_u8(low, high)));
+    }
+
+    unpack4Scalar(&packed[i / 2], length - i, table, &softBits[i]);
+}
+
+#else
+
+uint8_t PackedSoftBits::maxMagnitudeNEON(const uint8_t* softBits, size_t length) {
+    return maxMagnitudeScalar(softBits, length);
+}
+
+void PackedSoftBits::quantizeNEON(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized) {
+    quantizeScalar(softBits, length, multiplier, levels, quantized);
+}
+
+void PackedSoftBits::unpack4NEON(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits) {
+    unpack4Scalar(packed, length, table, softBits);
+}
+
+#endif
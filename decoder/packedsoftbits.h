@@ -0,0 +1,120 @@
+#ifndef PACKEDSOFTBITS_H
+#define PACKEDSOFTBITS_H
+
+#include <stdint.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Archive format of the soft bits with 3-6 bits per soft bit instead of 8.
+// Every block of BLOCK_SIZE soft bits starts with its scale, with adaptive scaling it is the largest magnitude in the block, so weak parts of the pass keep their resolution
+class PackedSoftBits {
+  public:
+    static constexpr uint32_t BLOCK_SIZE = 4096;
+    static constexpr int MIN_BITS = 3;
+    static constexpr int MAX_BITS = 6;
+
+  public:
+    class Writer {
+      public:
+        Writer(std::ostream& stream, int bits, bool adaptiveScale);
+
+        void write(const uint8_t* softBits, size_t length);
+
+        // Writes the last partial block and the final length into the header
+        void finish();
+
+      private:
+        void writeBlock(const uint8_t* softBits, size_t length);
+
+      private:
+        std::ostream& mStream;
+        int mBits;
+        bool mAdaptiveScale;
+        uint64_t mLength;
+        std::streampos mHeaderPos;
+        std::vector<uint8_t> mBlock;
+        std::vector<uint8_t> mPacked;
+    };
+
+    // Random access to a packed file in memory, only the blocks overlapping a read are unpacked
+    class Reader {
+      public:
+        Reader();
+
+        // False when the data is not a valid packed file
+        bool open(const uint8_t* data, size_t size);
+
+        uint64_t length() const {
+            return mLength;
+        }
+
+        // Unpacks length soft bits from pos on, safe to call from several threads
+        void read(uint64_t pos, size_t length, uint8_t* softBits) const;
+
+      private:
+        const uint8_t* mPacked;
+        int mBits;
+        uint64_t mLength;
+    };
+
+  public:
+    static bool isPackedPath(const std::string& path) {
+        return path.substr(path.find_last_of(".") + 1) == "sp";
+    }
+
+    // Number of soft bits in a packed file, 0 when the data is not a valid packed file
+    static uint64_t unpackedLength(const uint8_t* data, size_t size);
+
+    // Returns the number of bytes written to packed, which is packedBlockSize(length, bits)
+    static size_t packBlock(const uint8_t* softBits, size_t length, int bits, bool adaptiveScale, uint8_t* packed);
+    static void unpackBlock(const uint8_t* packed, size_t length, int bits, uint8_t* softBits);
+
+    static size_t packedBlockSize(size_t length, int bits) {
+        return 1 + (length + 7) / 8 * bits;
+    }
+
+  private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint8_t bits;
+        uint8_t adaptiveScale;
+        uint16_t reserved;
+        uint32_t blockSize;
+        uint64_t length;
+    };
+
+    typedef uint8_t (*MaxMagnitudeFunction)(const uint8_t* softBits, size_t length);
+    typedef void (*QuantizeFunction)(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized);
+    typedef void (*Unpack4Function)(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits);
+
+    struct Kernels {
+        Kernels();
+
+        MaxMagnitudeFunction maxMagnitude;
+        QuantizeFunction quantize;
+        Unpack4Function unpack4;
+    };
+
+    static uint8_t maxMagnitudeScalar(const uint8_t* softBits, size_t length);
+    static uint8_t maxMagnitudeSSE2(const uint8_t* softBits, size_t length);
+    static uint8_t maxMagnitudeNEON(const uint8_t* softBits, size_t length);
+
+    static void quantizeScalar(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized);
+    static void quantizeSSE2(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized);
+    static void quantizeNEON(const uint8_t* softBits, size_t length, int16_t multiplier, uint8_t levels, uint8_t* quantized);
+
+    static void unpack4Scalar(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits);
+    static void unpack4SSSE3(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits);
+    static void unpack4NEON(const uint8_t* packed, size_t length, const uint8_t* table, uint8_t* softBits);
+
+  private:
+    static const Kernels sKernels;
+
+    static constexpr uint32_t MAGIC = 0x4B50534D; // "MSPK"
+    static constexpr uint32_t VERSION = 1;
+};
+
+#endif // PACKEDSOFTBITS_H
@@ -8,7 +8,8 @@ PacketParser::PacketParser()
     , mPartialPacket(false)
     , mFirstTimeStamp(0)
     , mLastTimeStamp(0)
-    , mFirstTime(true) {}
+    , mFirstTime(true)
+    , mStats(nullptr) {}
 
 void PacketParser::parseFrame(const uint8_t* frame, int len) {
     int n;
@@ -91,6 +92,10 @@ void PacketParser::parseAPD(const uint8_t* packet, int len) {
 
     int ms = (packet[8] << 24) | (packet[9] << 16) | (packet[10] << 8) | packet[11];
 
+    if(mStats) {
+        mStats->packet(apd);
+    }
+
     if(apd == 70) {
         parse70(packet + 14, len - 14);
     } else {
@@ -105,6 +110,23 @@ void PacketParser::actAPD(const uint8_t* packet, int len, int apd, int pck_cnt)
     int q = packet[5];
 
     decMCUs(packet + 6, len - 6, apd, pck_cnt, mcu_id, q);
+    countMCUs();
+}
+
+void PacketParser::flushMCUs() {
+    waitForMCUs();
+    countMCUs();
+}
+
+void PacketParser::countMCUs() {
+    if(!mStats) {
+        return;
+    }
+
+    // MCUs decoded on the pool are counted when the next packet is parsed
+    for(int apd = FIRST_APID; apd < FIRST_APID + CHANNEL_COUNT; apd++) {
+        mStats->mcus(apd, takeDecodedMCUs(apd));
+    }
 }
 
 void PacketParser::parse70(const uint8_t* packet, int len) {
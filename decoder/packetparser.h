@@ -6,6 +6,7 @@
 #include <array>
 
 #include "TimeSpan.h"
+#include "decoderstats.h"
 #include "meteorimage.h"
 
 // Ported from https://github.com/artlav/meteor_decoder/blob/master/met_packet.pas
@@ -16,6 +17,14 @@ class PacketParser : public MeteorImage {
 
     void parseFrame(const uint8_t* frame, int len);
 
+    // Packets and MCUs are counted per APID when set
+    void setStats(DecoderStats* stats) {
+        mStats = stats;
+    }
+
+    // Waits for the queued MCUs so they are counted in the stats
+    void flushMCUs();
+
   public:
     const TimeSpan getFirstTimeStamp() const {
         int64_t pixelTime = (mLastTimeStamp - mFirstTimeStamp).Ticks() / (mLastHeightAtTimeStamp - mFirstHeightAtTimeStamp);
@@ -37,6 +46,7 @@ class PacketParser : public MeteorImage {
     void parseAPD(const uint8_t* packet, int len);
     void actAPD(const uint8_t* packet, int len, int apd, int pck_cnt);
     void parse70(const uint8_t* packet, int len);
+    void countMCUs();
 
   private:
     std::array<uint8_t, 2048> mPacketBuffer;
@@ -48,6 +58,7 @@ class PacketParser : public MeteorImage {
     int mFirstHeightAtTimeStamp;
     int mLastHeightAtTimeStamp;
     bool mFirstTime;
+    DecoderStats* mStats;
 
   private:
     static const int PACKET_FULL_MARK;
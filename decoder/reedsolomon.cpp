@@ -1,28 +1,326 @@
 #include "reedsolomon.h"
 
-#include <array>
+#include <string.h>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// CCSDS code, the first byte of a codeword is the highest degree coefficient
+const uint16_t cPolynomial = 0x187;
+const int cFirstRoot = 112;
+const int cRootGap = 11;
+
+struct GaloisField {
+    GaloisField() {
+        uint16_t x = 1;
+        for(int i = 0; i < 255; i++) {
+            exp[i] = static_cast<uint8_t>(x);
+            exp[i + 255] = static_cast<uint8_t>(x);
+            log[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if(x & 0x100) {
+                x ^= cPolynomial;
+            }
+        }
+        log[0] = 0;
+
+        for(int j = 0; j < ReedSolomon::ROOTS; j++) {
+            roots[j] = exp[(cRootGap * (cFirstRoot + j)) % 255];
+
+            // Every SIMD lane steps over INTERLEAVING symbols of its codeword at once
+            const uint8_t stride = power(roots[j], ReedSolomon::INTERLEAVING);
+            for(int n = 0; n < 16; n++) {
+                mulLow[j][n] = mul(stride, n);
+                mulHigh[j][n] = mul(stride, n << 4);
+            }
+            for(int lane = 0; lane < 4; lane++) {
+                laneWeights[j][lane] = power(roots[j], 3 - lane);
+            }
+        }
+    }
+
+    uint8_t mul(uint8_t a, uint8_t b) const {
+        return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]];
+    }
+
+    uint8_t div(uint8_t a, uint8_t b) const {
+        return a == 0 ? 0 : exp[log[a] + 255 - log[b]];
+    }
+
+    uint8_t power(uint8_t a, int n) const {
+        uint8_t result = 1;
+        for(int i = 0; i < n; i++) {
+            result = mul(result, a);
+        }
+        return result;
+    }
+
+    uint8_t exp[510];
+    uint8_t log[256];
+    uint8_t roots[ReedSolomon::ROOTS];
+    alignas(16) uint8_t mulLow[ReedSolomon::ROOTS][16];
+    alignas(16) uint8_t mulHigh[ReedSolomon::ROOTS][16];
+    uint8_t laneWeights[ReedSolomon::ROOTS][4];
+};
+
+const GaloisField sField;
+
+// The SIMD variants see the data as 64 blocks of 16 bytes, 4 symbols of each codeword per block.
+// A zero symbol is put in front so the 1020 bytes fill whole blocks, it does not change the syndromes.
+void combineLanes(const uint8_t lanes[16], int root, uint8_t syndromes[ReedSolomon::INTERLEAVING][ReedSolomon::ROOTS]) {
+    for(int c = 0; c < ReedSolomon::INTERLEAVING; c++) {
+        uint8_t syndrome = 0;
+        for(int lane = 0; lane < 4; lane++) {
+            syndrome ^= sField.mul(lanes[lane * ReedSolomon::INTERLEAVING + c], sField.laneWeights[root][lane]);
+        }
+        syndromes[c][root] = syndrome;
+    }
+}
+
+void firstBlock(const uint8_t* data, uint8_t block[16]) {
+    memset(block, 0, ReedSolomon::INTERLEAVING);
+    memcpy(&block[ReedSolomon::INTERLEAVING], data, 16 - ReedSolomon::INTERLEAVING);
+}
+
+} // namespace
 
 ReedSolomon::ReedSolomon()
-    : mpReedSolomon(nullptr) {
-    mpReedSolomon = correct_reed_solomon_create(cpolynomial, cFirstRoot, cRootGap, cNRoots);
+    : mSyndromes(syndromesScalar) {
+#if defined(CPU_FEATURES_X86)
+    if(CpuFeatures::hasAVX2()) {
+        mSyndromes = syndromesAVX2;
+    } else if(CpuFeatures::hasSSSE3()) {
+        mSyndromes = syndromesSSSE3;
+    }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+    mSyndromes = syndromesNEON;
+#endif
 }
 
-ReedSolomon::~ReedSolomon() {
-    correct_reed_solomon_destroy(mpReedSolomon);
+void ReedSolomon::decodeInterleaved(uint8_t* data, int results[INTERLEAVING]) {
+    uint8_t syndromes[INTERLEAVING][ROOTS];
+    mSyndromes(data, syndromes);
+
+    for(int c = 0; c < INTERLEAVING; c++) {
+        uint8_t any = 0;
+        for(int j = 0; j < ROOTS; j++) {
+            any |= syndromes[c][j];
+        }
+
+        results[c] = any == 0 ? 0 : correct(data, c, syndromes[c]);
+    }
 }
 
-void ReedSolomon::deinterleave(const uint8_t* data, int pos, int n) {
-    for(int i = 0; i < 255; i++) {
-        mWorkBuffer[i] = data[i * n + pos];
+// Berlekamp-Massey, Chien search and Forney on a single codeword
+int ReedSolomon::correct(uint8_t* data, int codeword, const uint8_t* syndromes) const {
+    uint8_t locator[ROOTS + 1] = {1};
+    uint8_t previous[ROOTS + 1] = {1};
+    uint8_t temp[ROOTS + 1];
+    int length = 0;
+    int shift = 1;
+    uint8_t previousDiscrepancy = 1;
+
+    for(int n = 0; n < ROOTS; n++) {
+        uint8_t discrepancy = syndromes[n];
+        for(int i = 1; i <= length; i++) {
+            discrepancy ^= sField.mul(locator[i], syndromes[n - i]);
+        }
+
+        if(discrepancy == 0) {
+            shift++;
+            continue;
+        }
+
+        const uint8_t scale = sField.div(discrepancy, previousDiscrepancy);
+        if(2 * length <= n) {
+            memcpy(temp, locator, sizeof(temp));
+            for(int i = 0; i + shift <= ROOTS; i++) {
+                locator[i + shift] ^= sField.mul(scale, previous[i]);
+            }
+            length = n + 1 - length;
+            memcpy(previous, temp, sizeof(previous));
+            previousDiscrepancy = discrepancy;
+            shift = 1;
+        } else {
+            for(int i = 0; i + shift <= ROOTS; i++) {
+                locator[i + shift] ^= sField.mul(scale, previous[i]);
+            }
+            shift++;
+        }
+    }
+
+    if(length > ROOTS / 2) {
+        return -1;
     }
+
+    // Error locators are powers of alpha^cRootGap, the error at degree d is a root of the locator at alpha^(-cRootGap * d)
+    int degrees[ROOTS / 2];
+    int found = 0;
+    for(int degree = 0; degree < BLOCK_LENGTH; degree++) {
+        const int inverseLog = (255 - (cRootGap * degree) % 255) % 255;
+        uint8_t value = locator[0];
+        for(int i = 1; i <= length; i++) {
+            value ^= sField.mul(locator[i], sField.exp[(inverseLog * i) % 255]);
+        }
+
+        if(value == 0) {
+            if(found == length) {
+                return -1;
+            }
+            degrees[found++] = degree;
+        }
+    }
+
+    if(found != length) {
+        return -1;
+    }
+
+    uint8_t evaluator[ROOTS / 2];
+    for(int i = 0; i < length; i++) {
+        evaluator[i] = 0;
+        for(int k = 0; k <= i; k++) {
+            evaluator[i] ^= sField.mul(syndromes[k], locator[i - k]);
+        }
+    }
+
+    for(int e = 0; e < found; e++) {
+        const int locatorLog = (cRootGap * degrees[e]) % 255;
+        const int inverseLog = (255 - locatorLog) % 255;
+
+        uint8_t numerator = 0;
+        for(int i = 0; i < length; i++) {
+            numerator ^= sField.mul(evaluator[i], sField.exp[(inverseLog * i) % 255]);
+        }
+
+        uint8_t denominator = 0;
+        for(int i = 1; i <= length; i += 2) {
+            denominator ^= sField.mul(locator[i], sField.exp[(inverseLog * (i - 1)) % 255]);
+        }
+
+        if(denominator == 0) {
+            return -1;
+        }
+
+        // X^(1 - first root) * numerator / denominator
+        const uint8_t scale = sField.exp[(locatorLog * (255 + 1 - cFirstRoot)) % 255];
+        const uint8_t magnitude = sField.mul(scale, sField.div(numerator, denominator));
+
+        data[(BLOCK_LENGTH - 1 - degrees[e]) * INTERLEAVING + codeword] ^= magnitude;
+    }
+
+    return found;
 }
 
-void ReedSolomon::interleave(uint8_t* output, int pos, int n) {
-    for(int i = 0; i < 255; i++) {
-        output[i * n + pos] = mResultBuffer[i];
+void ReedSolomon::syndromesScalar(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    for(int c = 0; c < INTERLEAVING; c++) {
+        for(int j = 0; j < ROOTS; j++) {
+            const uint8_t root = sField.roots[j];
+            uint8_t syndrome = 0;
+            for(int k = 0; k < BLOCK_LENGTH; k++) {
+                syndrome = sField.mul(syndrome, root) ^ data[k * INTERLEAVING + c];
+            }
+            syndromes[c][j] = syndrome;
+        }
     }
 }
 
-int ReedSolomon::decode() {
-    return correct_reed_solomon_decode(mpReedSolomon, mWorkBuffer, sizeof(mWorkBuffer), mResultBuffer);
+#if defined(CPU_FEATURES_X86)
+
+CPU_FEATURES_TARGET_SSSE3 void ReedSolomon::syndromesSSSE3(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    alignas(16) uint8_t first[16];
+    alignas(16) uint8_t lanes[16];
+    firstBlock(data, first);
+    const uint8_t* blocks = &data[16 - INTERLEAVING];
+    const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+    for(int j = 0; j < ROOTS; j++) {
+        const __m128i mulLow = _mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulLow[j]));
+        const __m128i mulHigh = _mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulHigh[j]));
+        __m128i accumulator = _mm_load_si128(reinterpret_cast<const __m128i*>(first));
+
+        for(int b = 0; b < 63; b++) {
+            const __m128i product = _mm_xor_si128(_mm_shuffle_epi8(mulLow, _mm_and_si128(accumulator, lowNibble)), _mm_shuffle_epi8(mulHigh, _mm_and_si128(_mm_srli_epi16(accumulator, 4), lowNibble)));
+            accumulator = _mm_xor_si128(product, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&blocks[b * 16])));
+        }
+
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+        combineLanes(lanes, j, syndromes);
+    }
 }
+
+// Two roots at once, one per 128 bit lane
+CPU_FEATURES_TARGET_AVX2 void ReedSolomon::syndromesAVX2(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    alignas(16) uint8_t first[16];
+    alignas(32) uint8_t lanes[32];
+    firstBlock(data, first);
+    const uint8_t* blocks = &data[16 - INTERLEAVING];
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+    const __m256i head = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(first)));
+
+    for(int j = 0; j < ROOTS; j += 2) {
+        const __m256i mulLow = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulLow[j]))), _mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulLow[j + 1])), 1);
+        const __m256i mulHigh = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulHigh[j]))), _mm_load_si128(reinterpret_cast<const __m128i*>(sField.mulHigh[j + 1])), 1);
+        __m256i accumulator = head;
+
+        for(int b = 0; b < 63; b++) {
+            const __m256i product = _mm256_xor_si256(_mm256_shuffle_epi8(mulLow, _mm256_and_si256(accumulator, lowNibble)), _mm256_shuffle_epi8(mulHigh, _mm256_and_si256(_mm256_srli_epi16(accumulator, 4), lowNibble)));
+            accumulator = _mm256_xor_si256(product, _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&blocks[b * 16]))));
+        }
+
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+        combineLanes(lanes, j, syndromes);
+        combineLanes(&lanes[16], j + 1, syndromes);
+    }
+}
+
+#else
+
+void ReedSolomon::syndromesSSSE3(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    syndromesScalar(data, syndromes);
+}
+
+void ReedSolomon::syndromesAVX2(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    syndromesScalar(data, syndromes);
+}
+
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+
+void ReedSolomon::syndromesNEON(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    uint8_t first[16];
+    uint8_t lanes[16];
+    firstBlock(data, first);
+    const uint8_t* blocks = &data[16 - INTERLEAVING];
+
+    for(int j = 0; j < ROOTS; j++) {
+        const uint8x16_t mulLow = vld1q_u8(sField.mulLow[j]);
+        const uint8x16_t mulHigh = vld1q_u8(sField.mulHigh[j]);
+        uint8x16_t accumulator = vld1q_u8(first);
+
+        for(int b = 0; b < 63; b++) {
+            const uint8x16_t product = veorq_u8(vqtbl1q_u8(mulLow, vandq_u8(accumulator, vdupq_n_u8(0x0F))), vqtbl1q_u8(mulHigh, vshrq_n_u8(accumulator, 4)));
+            accumulator = veorq_u8(product, vld1q_u8(&blocks[b * 16]));
+        }
+
+        vst1q_u8(lanes, accumulator);
+        combineLanes(lanes, j, syndromes);
+    }
+}
+
+#else
+
+void ReedSolomon::syndromesNEON(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]) {
+    syndromesScalar(data, syndromes);
+}
+
+#endif
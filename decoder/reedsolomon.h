@@ -2,29 +2,37 @@
 #define REEDSOLOMON_H
 
 #include <stdint.h>
-extern "C" {
-#include "correct.h"
-}
 
+// CCSDS (255,223) Reed-Solomon decoder working directly on the codewords interleaved in a CADU
 class ReedSolomon {
+  public:
+    static constexpr int INTERLEAVING = 4;
+    static constexpr int BLOCK_LENGTH = 255;
+    static constexpr int MESSAGE_LENGTH = 223;
+    static constexpr int ROOTS = BLOCK_LENGTH - MESSAGE_LENGTH;
+
   public:
     ReedSolomon();
-    ~ReedSolomon();
 
-    void deinterleave(const uint8_t* data, int pos, int n);
-    void interleave(uint8_t* output, int pos, int n);
-    int decode();
+    // data holds INTERLEAVING * BLOCK_LENGTH bytes, codeword c owns the bytes c, c + INTERLEAVING, ...
+    // Errors are corrected in place, results gets the number of corrected symbols per codeword or -1 if a codeword is not correctable
+    void decodeInterleaved(uint8_t* data, int results[INTERLEAVING]);
+
+  private:
+    // Selects the syndrome kernels directly to compare them with the scalar one
+    friend class ReedSolomonTest;
+
+    typedef void (*SyndromeFunction)(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]);
+
+    int correct(uint8_t* data, int codeword, const uint8_t* syndromes) const;
 
+    static void syndromesScalar(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]);
+    static void syndromesSSSE3(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]);
+    static void syndromesAVX2(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]);
+    static void syndromesNEON(const uint8_t* data, uint8_t syndromes[INTERLEAVING][ROOTS]);
 
   private:
-    correct_reed_solomon* mpReedSolomon;
-    uint8_t mWorkBuffer[255];
-    uint8_t mResultBuffer[255];
-
-    static constexpr uint16_t cpolynomial = correct_rs_primitive_polynomial_ccsds;
-    static constexpr uint8_t cFirstRoot = 112;
-    static constexpr uint8_t cRootGap = 11;
-    static constexpr uint8_t cNRoots = 32;
+    SyndromeFunction mSyndromes;
 };
 
 #endif // REEDSOLOMON_H
@@ -1,11 +1,83 @@
 #include "viterbi.h"
 
+#include <string.h>
+
+#include <algorithm>
+
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__) && !defined(__SSE2__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+namespace {
+
+// Meteor M2 convolutional code, the register holds the newest bit in the LSB like in libcorrect
+const uint8_t METEOR_POLYNOM_A = 0x4F;
+const uint8_t METEOR_POLYNOM_B = 0x6D;
+
+// Both polynomials have the newest and the oldest tap set, so flipping either end of the register inverts both outputs.
+// The branch metric of register r is x = |s0 - o0(r)| + |s1 - o1(r)|, the other three branches of its butterfly are 510 - x and x.
+struct BranchTable {
+    BranchTable() {
+        for(int r = 0; r < 128; r++) {
+            outputs[r] = parity(r & METEOR_POLYNOM_A) | (parity(r & METEOR_POLYNOM_B) << 1);
+        }
+        for(int p = 0; p < 32; p++) {
+            mask0[p] = (outputs[p * 2] & 1) ? 0xFF : 0x00;
+            mask1[p] = (outputs[p * 2] & 2) ? 0xFF : 0x00;
+        }
+    }
+
+    static uint8_t parity(int value) {
+        value ^= value >> 4;
+        value ^= value >> 2;
+        value ^= value >> 1;
+        return value & 1;
+    }
+
+    uint8_t outputs[128];
+    alignas(32) int16_t mask0[32];
+    alignas(32) int16_t mask1[32];
+};
+
+const BranchTable sBranchTable;
+
+} // namespace
+
 Viterbi::Viterbi(int k, uint8_t polynomA, uint8_t polynomB)
-    : mpConvolutional(nullptr) {
+    : mpConvolutional(nullptr)
+    , mAcs(nullptr)
+    , mNextOutputStep(0)
+    , mHistoryLength(0)
+    , mStreamSkip(0) {
     mPolynomials[0] = polynomA;
     mPolynomials[1] = polynomB;
 
     mpConvolutional = correct_convolutional_create(2, k, mPolynomials);
+
+    if(k == K && polynomA == METEOR_POLYNOM_A && polynomB == METEOR_POLYNOM_B) {
+        mAcs = acsScalar;
+#if defined(CPU_FEATURES_X86)
+        if(CpuFeatures::hasAVX2()) {
+            mAcs = acsAVX2;
+        } else if(CpuFeatures::hasSSE2()) {
+            mAcs = acsSSE2;
+        }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+        mAcs = acsNEON;
+#endif
+    }
 }
 
 Viterbi::~Viterbi() {
@@ -15,5 +87,407 @@ Viterbi::~Viterbi() {
 }
 
 size_t Viterbi::decodeSoft(const uint8_t* data, uint8_t* result, size_t blockSize) {
+    if(mAcs != nullptr && blockSize % 2 == 0 && blockSize / 2 > 2 * (K - 1)) {
+        return decodeSoftK7(data, result, blockSize);
+    }
     return correct_convolutional_decode_soft(mpConvolutional, data, blockSize, result);
 }
+
+// Same warm up, traceback schedule, tie breaking and zero tail as libcorrect, so the output is bit-exact
+size_t Viterbi::decodeSoftK7(const uint8_t* data, uint8_t* result, size_t blockSize) {
+    const size_t steps = blockSize / 2;
+    const size_t tailStart = steps - (K - 1);
+    const size_t historyCapacity = TRACEBACK_MIN_LENGTH + TRACEBACK_GROUP_LENGTH;
+    // The last K - 1 input bits are only flushed out of the register, they are not decoded
+    const size_t outputBytes = (steps - (K - 1) + 7) / 8;
+
+    if(mDecisions.size() < steps) {
+        mDecisions.resize(steps);
+    }
+
+    std::fill(mMetrics, mMetrics + STATES, UNREACHABLE_METRIC);
+    mMetrics[0] = 0;
+    memset(result, 0, outputBytes);
+
+    // Warm up from the all zero state, the first decoded bit leaves the register K - 1 steps later
+    mAcs(data, K - 1, mMetrics, mDecisions.data());
+    mNextOutputStep = K - 1;
+
+    size_t step = K - 1;
+    size_t historyLength = 0;
+    while(step < tailStart) {
+        const size_t count = std::min(tailStart - step, historyCapacity - historyLength);
+        mAcs(&data[step * 2], count, mMetrics, &mDecisions[step]);
+        step += count;
+        historyLength += count;
+
+        if(historyLength == historyCapacity) {
+            traceback(result, step - 1, bestState(mMetrics, 1), TRACEBACK_MIN_LENGTH);
+            historyLength = TRACEBACK_MIN_LENGTH;
+        }
+    }
+
+    for(; step < steps; step++) {
+        const uint32_t skip = 1 << (K - (steps - step));
+        acsTail(&data[step * 2], skip, mMetrics, &mDecisions[step]);
+        historyLength++;
+
+        if(historyLength == historyCapacity) {
+            traceback(result, step, bestState(mMetrics, skip), TRACEBACK_MIN_LENGTH);
+            historyLength = TRACEBACK_MIN_LENGTH;
+        }
+    }
+
+    traceback(result, steps - 1, 0, 0);
+
+    return outputBytes;
+}
+
+void Viterbi::traceback(uint8_t* result, size_t lastStep, uint32_t state, size_t skipLength) {
+    size_t step = lastStep + 1;
+
+    for(size_t i = 0; i < skipLength; i++) {
+        step--;
+        const uint32_t highBit = (mDecisions[step] >> state) & 1;
+        state = (state >> 1) | (highBit << (K - 2));
+    }
+
+    const size_t firstUnwritten = step;
+    while(step > mNextOutputStep) {
+        step--;
+        const uint32_t highBit = (mDecisions[step] >> state) & 1;
+        state = (state >> 1) | (highBit << (K - 2));
+
+        // The bit leaving the register is the input K - 1 steps earlier
+        const size_t bit = step - (K - 1);
+        result[bit / 8] |= highBit << (7 - bit % 8);
+    }
+
+    mNextOutputStep = firstUnwritten;
+}
+
+void Viterbi::resetStream() {
+    // The encoder state is unknown in the middle of a stream
+    std::fill(mMetrics, mMetrics + STATES, 0);
+    mDecisions.resize(TRACEBACK_MIN_LENGTH + TRACEBACK_GROUP_LENGTH);
+    mHistoryLength = 0;
+    // The first K - 1 decisions only tell the register content before the stream start
+    mStreamSkip = K - 1;
+}
+
+// Same sliding window schedule as decodeSoftK7(), the newest TRACEBACK_MIN_LENGTH decisions are kept for the next traceback
+void Viterbi::decodeStream(const uint8_t* data, size_t length, std::vector<uint8_t>& bits) {
+    const size_t steps = length / 2;
+    const size_t historyCapacity = TRACEBACK_MIN_LENGTH + TRACEBACK_GROUP_LENGTH;
+
+    for(size_t step = 0; step < steps;) {
+        const size_t count = std::min(steps - step, historyCapacity - mHistoryLength);
+        mAcs(&data[step * 2], count, mMetrics, &mDecisions[mHistoryLength]);
+        step += count;
+        mHistoryLength += count;
+
+        if(mHistoryLength == historyCapacity) {
+            streamTraceback(bits, bestState(mMetrics, 1), TRACEBACK_MIN_LENGTH);
+        }
+    }
+}
+
+void Viterbi::flushStream(std::vector<uint8_t>& bits) {
+    const uint32_t state = bestState(mMetrics, 1);
+    streamTraceback(bits, state, 0);
+
+    // The last K - 1 bits have no decision yet, they are the register content of the best state
+    for(int i = K - 2; i >= 0; i--) {
+        if(mStreamSkip > 0) {
+            mStreamSkip--;
+            continue;
+        }
+        bits.push_back((state >> i) & 1);
+    }
+}
+
+void Viterbi::streamTraceback(std::vector<uint8_t>& bits, uint32_t state, size_t skipLength) {
+    size_t step = mHistoryLength;
+
+    for(size_t i = 0; i < skipLength && step > 0; i++) {
+        step--;
+        const uint32_t highBit = (mDecisions[step] >> state) & 1;
+        state = (state >> 1) | (highBit << (K - 2));
+    }
+
+    const size_t outputSteps = step;
+    const size_t skip = std::min(mStreamSkip, outputSteps);
+    const size_t first = bits.size();
+    bits.resize(first + outputSteps - skip);
+
+    while(step > 0) {
+        step--;
+        const uint32_t highBit = (mDecisions[step] >> state) & 1;
+        state = (state >> 1) | (highBit << (K - 2));
+
+        if(step >= skip) {
+            bits[first + step - skip] = static_cast<uint8_t>(highBit);
+        }
+    }
+
+    std::copy(mDecisions.begin() + outputSteps, mDecisions.begin() + mHistoryLength, mDecisions.begin());
+    mHistoryLength -= outputSteps;
+    mStreamSkip -= skip;
+}
+
+uint32_t Viterbi::bestState(const int16_t* metrics, uint32_t skip) {
+    uint32_t best = 0;
+    for(uint32_t state = skip; state < STATES; state += skip) {
+        if(metrics[state] < metrics[best]) {
+            best = state;
+        }
+    }
+    return best;
+}
+
+// During the tail only zeros are shifted in, only every skip-th state is reachable
+void Viterbi::acsTail(const uint8_t* softBits, uint32_t skip, int16_t* metrics, uint64_t* decision) {
+    int16_t next[STATES];
+    std::copy(metrics, metrics + STATES, next);
+    *decision = 0;
+
+    for(uint32_t state = 0; state < STATES; state += skip) {
+        const uint8_t output = sBranchTable.outputs[state];
+        const int branch = ((output & 1) ? 255 - softBits[0] : softBits[0]) + ((output & 2) ? 255 - softBits[1] : softBits[1]);
+        const int low = metrics[state >> 1] + branch;
+        const int high = metrics[(state >> 1) | (STATES / 2)] + 510 - branch;
+
+        // libcorrect breaks ties towards the high predecessor in the tail
+        if(low < high) {
+            next[state] = low;
+        } else {
+            next[state] = high;
+            *decision |= uint64_t(1) << state;
+        }
+    }
+
+    std::copy(next, next + STATES, metrics);
+}
+
+void Viterbi::acsScalar(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    int16_t next[STATES];
+
+    for(size_t i = 0; i < steps; i++) {
+        const int s0 = softBits[i * 2];
+        const int s1 = softBits[i * 2 + 1];
+        uint64_t decision = 0;
+
+        for(int p = 0; p < STATES / 2; p++) {
+            const int x = (s0 ^ sBranchTable.mask0[p]) + (s1 ^ sBranchTable.mask1[p]);
+            const int y = 510 - x;
+            const int low = metrics[p];
+            const int high = metrics[p + STATES / 2];
+
+            // Ties keep the predecessor with the oldest bit cleared
+            const int evenLow = low + x;
+            const int evenHigh = high + y;
+            next[p * 2] = evenHigh < evenLow ? evenHigh : evenLow;
+            decision |= uint64_t(evenHigh < evenLow) << (p * 2);
+
+            const int oddLow = low + y;
+            const int oddHigh = high + x;
+            next[p * 2 + 1] = oddHigh < oddLow ? oddHigh : oddLow;
+            decision |= uint64_t(oddHigh < oddLow) << (p * 2 + 1);
+        }
+
+        const int16_t norm = next[0];
+        for(int n = 0; n < STATES; n++) {
+            metrics[n] = next[n] - norm;
+        }
+        decisions[i] = decision;
+    }
+}
+
+#if defined(CPU_FEATURES_X86)
+
+TARGET_SSE2 void Viterbi::acsSSE2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    __m128i low[4];
+    __m128i high[4];
+    __m128i mask0[4];
+    __m128i mask1[4];
+    for(int q = 0; q < 4; q++) {
+        low[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&metrics[q * 8]));
+        high[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&metrics[q * 8 + 32]));
+        mask0[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(&sBranchTable.mask0[q * 8]));
+        mask1[q] = _mm_load_si128(reinterpret_cast<const __m128i*>(&sBranchTable.mask1[q * 8]));
+    }
+    const __m128i maxBranchMetric = _mm_set1_epi16(510);
+
+    for(size_t i = 0; i < steps; i++) {
+        const __m128i s0 = _mm_set1_epi16(softBits[i * 2]);
+        const __m128i s1 = _mm_set1_epi16(softBits[i * 2 + 1]);
+        __m128i next[8];
+        uint64_t decision = 0;
+
+        for(int q = 0; q < 4; q++) {
+            const __m128i x = _mm_add_epi16(_mm_xor_si128(s0, mask0[q]), _mm_xor_si128(s1, mask1[q]));
+            const __m128i y = _mm_sub_epi16(maxBranchMetric, x);
+
+            const __m128i evenLow = _mm_adds_epi16(low[q], x);
+            const __m128i evenHigh = _mm_adds_epi16(high[q], y);
+            const __m128i oddLow = _mm_adds_epi16(low[q], y);
+            const __m128i oddHigh = _mm_adds_epi16(high[q], x);
+
+            const __m128i even = _mm_min_epi16(evenLow, evenHigh);
+            const __m128i odd = _mm_min_epi16(oddLow, oddHigh);
+            const __m128i evenDecision = _mm_cmpgt_epi16(evenLow, evenHigh);
+            const __m128i oddDecision = _mm_cmpgt_epi16(oddLow, oddHigh);
+
+            // Interleave even and odd successors back into state order
+            next[q * 2] = _mm_unpacklo_epi16(even, odd);
+            next[q * 2 + 1] = _mm_unpackhi_epi16(even, odd);
+            const __m128i decisionBytes = _mm_packs_epi16(_mm_unpacklo_epi16(evenDecision, oddDecision), _mm_unpackhi_epi16(evenDecision, oddDecision));
+            decision |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(decisionBytes))) << (q * 16);
+        }
+
+        const __m128i norm = _mm_shuffle_epi32(_mm_shufflelo_epi16(next[0], 0), 0);
+        for(int q = 0; q < 4; q++) {
+            low[q] = _mm_sub_epi16(next[q], norm);
+            high[q] = _mm_sub_epi16(next[q + 4], norm);
+        }
+        decisions[i] = decision;
+    }
+
+    for(int q = 0; q < 4; q++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&metrics[q * 8]), low[q]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&metrics[q * 8 + 32]), high[q]);
+    }
+}
+
+CPU_FEATURES_TARGET_AVX2 void Viterbi::acsAVX2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    __m256i low[2];
+    __m256i high[2];
+    __m256i mask0[2];
+    __m256i mask1[2];
+    for(int q = 0; q < 2; q++) {
+        low[q] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&metrics[q * 16]));
+        high[q] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&metrics[q * 16 + 32]));
+        mask0[q] = _mm256_load_si256(reinterpret_cast<const __m256i*>(&sBranchTable.mask0[q * 16]));
+        mask1[q] = _mm256_load_si256(reinterpret_cast<const __m256i*>(&sBranchTable.mask1[q * 16]));
+    }
+    const __m256i maxBranchMetric = _mm256_set1_epi16(510);
+
+    for(size_t i = 0; i < steps; i++) {
+        const __m256i s0 = _mm256_set1_epi16(softBits[i * 2]);
+        const __m256i s1 = _mm256_set1_epi16(softBits[i * 2 + 1]);
+        __m256i next[4];
+        uint64_t decision = 0;
+
+        for(int q = 0; q < 2; q++) {
+            const __m256i x = _mm256_add_epi16(_mm256_xor_si256(s0, mask0[q]), _mm256_xor_si256(s1, mask1[q]));
+            const __m256i y = _mm256_sub_epi16(maxBranchMetric, x);
+
+            const __m256i evenLow = _mm256_adds_epi16(low[q], x);
+            const __m256i evenHigh = _mm256_adds_epi16(high[q], y);
+            const __m256i oddLow = _mm256_adds_epi16(low[q], y);
+            const __m256i oddHigh = _mm256_adds_epi16(high[q], x);
+
+            const __m256i even = _mm256_min_epi16(evenLow, evenHigh);
+            const __m256i odd = _mm256_min_epi16(oddLow, oddHigh);
+            const __m256i evenDecision = _mm256_cmpgt_epi16(evenLow, evenHigh);
+            const __m256i oddDecision = _mm256_cmpgt_epi16(oddLow, oddHigh);
+
+            // The unpacks work per 128 bit lane, the lane halves are put back into state order afterwards
+            const __m256i interleavedLow = _mm256_unpacklo_epi16(even, odd);
+            const __m256i interleavedHigh = _mm256_unpackhi_epi16(even, odd);
+            next[q * 2] = _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x20);
+            next[q * 2 + 1] = _mm256_permute2x128_si256(interleavedLow, interleavedHigh, 0x31);
+
+            // Packing the unpacked decisions lane by lane already gives state order
+            const __m256i decisionBytes = _mm256_packs_epi16(_mm256_unpacklo_epi16(evenDecision, oddDecision), _mm256_unpackhi_epi16(evenDecision, oddDecision));
+            decision |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(decisionBytes))) << (q * 32);
+        }
+
+        const __m256i norm = _mm256_broadcastw_epi16(_mm256_castsi256_si128(next[0]));
+        low[0] = _mm256_sub_epi16(next[0], norm);
+        low[1] = _mm256_sub_epi16(next[1], norm);
+        high[0] = _mm256_sub_epi16(next[2], norm);
+        high[1] = _mm256_sub_epi16(next[3], norm);
+        decisions[i] = decision;
+    }
+
+    for(int q = 0; q < 2; q++) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&metrics[q * 16]), low[q]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&metrics[q * 16 + 32]), high[q]);
+    }
+}
+
+#else
+
+void Viterbi::acsSSE2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    acsScalar(softBits, steps, metrics, decisions);
+}
+
+void Viterbi::acsAVX2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    acsScalar(softBits, steps, metrics, decisions);
+}
+
+#endif
+
+#if defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+
+void Viterbi::acsNEON(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    int16x8_t low[4];
+    int16x8_t high[4];
+    int16x8_t mask0[4];
+    int16x8_t mask1[4];
+    for(int q = 0; q < 4; q++) {
+        low[q] = vld1q_s16(&metrics[q * 8]);
+        high[q] = vld1q_s16(&metrics[q * 8 + 32]);
+        mask0[q] = vld1q_s16(&sBranchTable.mask0[q * 8]);
+        mask1[q] = vld1q_s16(&sBranchTable.mask1[q * 8]);
+    }
+    const int16x8_t maxBranchMetric = vdupq_n_s16(510);
+    const uint16_t bitWeights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint16x8_t weights = vld1q_u16(bitWeights);
+
+    for(size_t i = 0; i < steps; i++) {
+        const int16x8_t s0 = vdupq_n_s16(softBits[i * 2]);
+        const int16x8_t s1 = vdupq_n_s16(softBits[i * 2 + 1]);
+        int16x8_t next[8];
+        uint64_t decision = 0;
+
+        for(int q = 0; q < 4; q++) {
+            const int16x8_t x = vaddq_s16(veorq_s16(s0, mask0[q]), veorq_s16(s1, mask1[q]));
+            const int16x8_t y = vsubq_s16(maxBranchMetric, x);
+
+            const int16x8_t evenLow = vqaddq_s16(low[q], x);
+            const int16x8_t evenHigh = vqaddq_s16(high[q], y);
+            const int16x8_t oddLow = vqaddq_s16(low[q], y);
+            const int16x8_t oddHigh = vqaddq_s16(high[q], x);
+
+            const int16x8x2_t interleaved = vzipq_s16(vminq_s16(evenLow, evenHigh), vminq_s16(oddLow, oddHigh));
+            next[q * 2] = interleaved.val[0];
+            next[q * 2 + 1] = interleaved.val[1];
+
+            const uint16x8x2_t decisionMasks = vzipq_u16(vcgtq_s16(evenLow, evenHigh), vcgtq_s16(oddLow, oddHigh));
+            const uint64_t bits = vaddvq_u16(vandq_u16(decisionMasks.val[0], weights)) | (vaddvq_u16(vandq_u16(decisionMasks.val[1], weights)) << 8);
+            decision |= bits << (q * 16);
+        }
+
+        const int16x8_t norm = vdupq_laneq_s16(next[0], 0);
+        for(int q = 0; q < 4; q++) {
+            low[q] = vsubq_s16(next[q], norm);
+            high[q] = vsubq_s16(next[q + 4], norm);
+        }
+        decisions[i] = decision;
+    }
+
+    for(int q = 0; q < 4; q++) {
+        vst1q_s16(&metrics[q * 8], low[q]);
+        vst1q_s16(&metrics[q * 8 + 32], high[q]);
+    }
+}
+
+#else
+
+void Viterbi::acsNEON(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions) {
+    acsScalar(softBits, steps, metrics, decisions);
+}
+
+#endif
@@ -2,6 +2,8 @@
 #define VITERBI_H
 
 #include <stdint.h>
+
+#include <vector>
 extern "C" {
 #include "correct.h"
 }
@@ -13,9 +15,50 @@ class Viterbi {
 
     size_t decodeSoft(const uint8_t* data, uint8_t* result, size_t blockSize);
 
+    // Continuous decoding of an unterminated stream, only for the Meteor K = 7 code.
+    // Every soft bit pair appends one decoded bit (0 or 1) to bits, delayed by the traceback depth, the first bit belongs to the first pair after resetStream().
+    bool isStreamingSupported() const {
+        return mAcs != nullptr;
+    }
+    void resetStream();
+    void decodeStream(const uint8_t* data, size_t length, std::vector<uint8_t>& bits);
+    void flushStream(std::vector<uint8_t>& bits);
+
+  private:
+    // Selects the ACS kernels directly to compare them against libcorrect
+    friend class ViterbiTest;
+
+    // Add-compare-select over the full trellis for steps symbol pairs, one decision bit per state and step
+    typedef void (*AcsFunction)(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions);
+
+    size_t decodeSoftK7(const uint8_t* data, uint8_t* result, size_t blockSize);
+    void traceback(uint8_t* result, size_t lastStep, uint32_t state, size_t skipLength);
+    static void acsTail(const uint8_t* softBits, uint32_t skip, int16_t* metrics, uint64_t* decision);
+    void streamTraceback(std::vector<uint8_t>& bits, uint32_t state, size_t skipLength);
+    static uint32_t bestState(const int16_t* metrics, uint32_t skip);
+
+    static void acsScalar(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions);
+    static void acsSSE2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions);
+    static void acsAVX2(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions);
+    static void acsNEON(const uint8_t* softBits, size_t steps, int16_t* metrics, uint64_t* decisions);
+
   private:
     correct_convolutional_polynomial_t mPolynomials[2];
     correct_convolutional* mpConvolutional;
+    AcsFunction mAcs;
+    std::vector<uint64_t> mDecisions;
+    size_t mNextOutputStep;
+    size_t mHistoryLength;
+    size_t mStreamSkip;
+    alignas(32) int16_t mMetrics[64];
+
+  private:
+    static constexpr int K = 7;
+    static constexpr int STATES = 1 << (K - 1);
+    static constexpr int16_t UNREACHABLE_METRIC = 0x2000;
+    // libcorrect's traceback schedule (5 * K and 15 * K steps), followed to stay bit-exact with it
+    static constexpr size_t TRACEBACK_MIN_LENGTH = 5 * K;
+    static constexpr size_t TRACEBACK_GROUP_LENGTH = 15 * K;
 };
 
 #endif // VITERBI_H
@@ -1,9 +1,11 @@
 #include <chrono>
+#include <cstring>
 #include <ctime>
 #include <exception>
 #include <experimental/filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <opencv2/imgcodecs.hpp>
 #include <sstream>
@@ -13,7 +15,12 @@
 #include "DSP/wavreader.h"
 #include "GIS/shapereader.h"
 #include "GIS/shaperenderer.h"
+#include "caduindex.h"
+#include "framejournal.h"
+#include "configdetector.h"
+#include "memorymappedfile.h"
 #include "meteordecoder.h"
+#include "packedsoftbits.h"
 #include "pixelgeolocationcalculator.h"
 #include "settings.h"
 #include "spreadimage.h"
@@ -32,6 +39,20 @@ struct ImageForSpread {
     std::string fileNameBase;
 };
 
+// Raw .s files are mapped as they are, packed .sp files are only unpacked block by block while they are read
+struct SoftBitsInput {
+    bool open(const std::string& path);
+    uint64_t length() const;
+
+    // Points into the mapping of a raw file, a packed range is unpacked into buffer
+    const uint8_t* read(uint64_t pos, size_t length, std::vector<uint8_t>& buffer) const;
+    void copy(uint64_t pos, size_t length, uint8_t* softBits) const;
+
+    MemoryMappedFile file;
+    PackedSoftBits::Reader packed;
+    bool isPacked = false;
+};
+
 void searchForImages(std::list<cv::Mat>& imagesOut, std::list<PixelGeolocationCalculator>& geolocationCalculatorsOut, const std::string& channelName);
 void saveImage(const std::string fileName, const cv::Mat& image);
 void writeSymbolToFile(std::ostream& stream, const Wavreader::complex& sample);
@@ -39,6 +60,8 @@ void writeSymbolToFile(std::ostream& stream, const Wavreader::complex& sample);
 static std::mutex saveImageMutex;
 static Settings& mSettings = Settings::getInstance();
 static ThreadPool mThreadPool(std::thread::hardware_concurrency());
+// Soft bits pushed to the decoder at once
+static const size_t SOFT_BITS_CHUNK = 4 * 1024 * 1024;
 
 int main(int argc, char* argv[]) {
     mSettings.parseArgs(argc, argv);
@@ -56,61 +79,191 @@ int main(int argc, char* argv[]) {
 
     mThreadPool.start();
 
-    MeteorDecoder meteorDecoder(mSettings.deInterleave(), mSettings.getDemodulatorMode() == "oqpsk", mSettings.differentialDecode());
+    std::string inputPath = mSettings.getInputFilePath();
+    const bool inputIsWav = inputPath.substr(inputPath.find_last_of(".") + 1) == "wav";
+    const bool inputIsFrames = inputPath.substr(inputPath.find_last_of(".") + 1) == "frames";
+
+    ConfigDetector::Configuration configuration;
+    configuration.oqpsk = mSettings.getDemodulatorMode() == "oqpsk";
+    configuration.differentialDecode = mSettings.differentialDecode();
+    configuration.deInterleave = mSettings.deInterleave();
+
+    if(mSettings.autoDetect() && !inputIsFrames) {
+        std::cout << "Detecting mode, differential decoding and deinterleaving..." << std::endl;
+
+        ConfigDetector configDetector(mThreadPool, mSettings.getSymbolRate(), mSettings.getAutoDetectLength());
+        bool detected = false;
+
+        if(inputIsWav) {
+            ConfigDetector::DemodulatorSettings demodulatorSettings;
+            demodulatorSettings.symbolRate = mSettings.getSymbolRate();
+            demodulatorSettings.costasBandwidth = mSettings.getCostasBandwidth();
+            demodulatorSettings.rrcFilterOrder = mSettings.getRRCFilterOrder();
+            demodulatorSettings.waitForLock = mSettings.waitForlock();
+            demodulatorSettings.brokenModulation = mSettings.getBrokenModulation();
+            detected = configDetector.detect(inputPath, demodulatorSettings, configuration);
+        } else {
+            SoftBitsInput softBits;
+            if(softBits.open(inputPath)) {
+                std::vector<uint8_t> buffer;
+                const size_t length = std::min<uint64_t>(softBits.length(), configDetector.getPrefixLength());
+                detected = configDetector.detect(softBits.read(0, length, buffer), length, configuration);
+            }
+        }
+
+        if(detected) {
+            std::cout << "Detected mode:" << (configuration.oqpsk ? "oqpsk" : "qpsk") << " diff:" << configuration.differentialDecode << " int:" << configuration.deInterleave << std::endl;
+        } else {
+            std::cout << "Auto detection failed, using the given settings" << std::endl;
+        }
+    }
+
+    MeteorDecoder meteorDecoder(configuration.deInterleave, configuration.oqpsk, configuration.differentialDecode);
+    int frameDecodeThreads = mThreadPool.getNumberOfThreads();
+    if(mSettings.getFrameDecodeThreads() > 0) {
+        frameDecodeThreads = std::min(mSettings.getFrameDecodeThreads(), frameDecodeThreads);
+    }
+    meteorDecoder.setThreadPool(&mThreadPool, frameDecodeThreads);
+    meteorDecoder.setContinuousViterbi(mSettings.continuousViterbi());
+    meteorDecoder.setIntegerIdct(mSettings.integerIdct());
+    meteorDecoder.setRequestedChannels(mSettings.getDecodedChannels());
+
+    std::ofstream statsStream;
+    if(!mSettings.getStatsFile().empty()) {
+        statsStream.open(mSettings.getStatsFile(), std::ios::out | std::ios::trunc);
+        if(statsStream.is_open()) {
+            meteorDecoder.setStatsOutput(&statsStream, mSettings.getStatsInterval());
+        } else {
+            std::cout << "Unable to open decoder statistics file: " << mSettings.getStatsFile() << std::endl;
+        }
+    }
 
     size_t decodedPacketCounter = 0;
-    std::string inputPath = mSettings.getInputFilePath();
     try {
-        if(inputPath.substr(inputPath.find_last_of(".") + 1) == "wav") {
-            std::cout << "Input is a .wav file, processing it..." << std::endl;
+        if(inputIsFrames) {
+            std::cout << "Input is a frame journal, rebuilding images from it..." << std::endl;
+            decodedPacketCounter = FrameJournal::replay(inputPath, meteorDecoder);
+        } else {
+            if(inputIsWav) {
+                std::cout << "Input is a .wav file, processing it..." << std::endl;
 
-            const std::string outputPath = inputPath.substr(0, inputPath.find_last_of(".") + 1) + "s";
-            std::ofstream outputStream;
-            outputStream.open(outputPath, std::ios::binary);
+                const int packedBits = mSettings.getPackedSoftBits();
+                const std::string outputPath = inputPath.substr(0, inputPath.find_last_of(".") + 1) + (packedBits > 0 ? "sp" : "s");
+                std::ofstream outputStream;
+                outputStream.open(outputPath, std::ios::binary);
 
-            if(!outputStream.is_open()) {
-                throw std::runtime_error("Creating output .S file failed, demodulating aborted");
-            }
+                if(!outputStream.is_open()) {
+                    throw std::runtime_error("Creating output .S file failed, demodulating aborted");
+                }
 
-            Wavreader wavReader;
-            if(!wavReader.openFile(inputPath)) {
-                throw std::runtime_error("Opening .wav file failed, demodulating aborted");
-            }
+                Wavreader wavReader;
+                if(!wavReader.openFile(inputPath)) {
+                    throw std::runtime_error("Opening .wav file failed, demodulating aborted");
+                }
 
-            DSP::MeteorCostas::Mode mode = DSP::MeteorCostas::QPSK;
-            if(mSettings.getDemodulatorMode() == "oqpsk") {
-                mode = DSP::MeteorCostas::OQPSK;
-            }
+                DSP::MeteorCostas::Mode mode = DSP::MeteorCostas::QPSK;
+                if(configuration.oqpsk) {
+                    mode = DSP::MeteorCostas::OQPSK;
+                }
 
 
-            DSP::MeteorDemodulator demodulator(mode, mSettings.getSymbolRate(), mSettings.getCostasBandwidth(), mSettings.getRRCFilterOrder(), mSettings.waitForlock(), mSettings.getBrokenModulation());
-            demodulator.process(wavReader, [&outputStream](const Wavreader::complex& sample, float) {
-                writeSymbolToFile(outputStream, sample);
-            });
+                DSP::MeteorDemodulator demodulator(mode, mSettings.getSymbolRate(), mSettings.getCostasBandwidth(), mSettings.getRRCFilterOrder(), mSettings.waitForlock(), mSettings.getBrokenModulation());
 
-            outputStream.flush();
-            outputStream.close();
-            inputPath = outputPath;
-        }
+                DSP::ConsoleTelemetry consoleTelemetry;
+                std::unique_ptr<DSP::JsonLinesTelemetry> jsonTelemetry;
+                demodulator.setTelemetryInterval(mSettings.getTelemetryInterval());
+                demodulator.addTelemetry(&consoleTelemetry);
+                if(!mSettings.getTelemetryFile().empty()) {
+                    jsonTelemetry = std::make_unique<DSP::JsonLinesTelemetry>(mSettings.getTelemetryFile());
+                    if(jsonTelemetry->isOpen()) {
+                        demodulator.addTelemetry(jsonTelemetry.get());
+                    } else {
+                        std::cout << "Unable to open telemetry file: " << mSettings.getTelemetryFile() << std::endl;
+                    }
+                }
+                std::unique_ptr<PackedSoftBits::Writer> packedWriter;
+                if(packedBits > 0) {
+                    packedWriter = std::make_unique<PackedSoftBits::Writer>(outputStream, packedBits, mSettings.adaptiveSoftBitScaling());
+                }
 
-        std::ifstream binaryData(inputPath, std::ifstream::binary);
-        if(!binaryData) {
-            throw std::runtime_error("Opening input file failed");
-        }
+                demodulator.process(wavReader, [&outputStream, &packedWriter](const Wavreader::complex& sample, float) {
+                    if(packedWriter) {
+                        int8_t softBits[2];
+                        DSP::MeteorDemodulator::symbolToSoftBits(sample, softBits);
+                        packedWriter->write(reinterpret_cast<const uint8_t*>(softBits), sizeof(softBits));
+                    } else {
+                        writeSymbolToFile(outputStream, sample);
+                    }
+                });
 
-        binaryData.seekg(0, binaryData.end);
-        int64_t fileLength = binaryData.tellg();
-        binaryData.seekg(0, binaryData.beg);
+                if(packedWriter) {
+                    packedWriter->finish();
+                }
 
-        auto softBits = std::make_unique<uint8_t[]>(fileLength);
+                outputStream.flush();
+                outputStream.close();
+                inputPath = outputPath;
+            }
 
-        binaryData.read(reinterpret_cast<char*>(softBits.get()), fileLength);
-        decodedPacketCounter = meteorDecoder.decode(softBits.get(), fileLength);
+            SoftBitsInput softBits;
+            if(!softBits.open(inputPath)) {
+                throw std::runtime_error("Opening input file failed");
+            }
 
-        if(binaryData && binaryData.is_open()) {
-            binaryData.close();
-        }
+            FrameJournal frameJournal;
+            if(mSettings.frameJournal()) {
+                if(frameJournal.open(FrameJournal::pathFor(inputPath))) {
+                    meteorDecoder.setFrameJournal(&frameJournal);
+                } else {
+                    std::cout << "Unable to create frame journal: " << FrameJournal::pathFor(inputPath) << std::endl;
+                }
+            }
+
+            float rangeStart = 0.0f;
+            float rangeEnd = std::numeric_limits<float>::max();
+            const bool hasRange = mSettings.getTimeRange(rangeStart, rangeEnd);
+
+            const std::string indexPath = CaduIndex::pathFor(inputPath);
+            CaduIndex caduIndex;
 
+            if(mSettings.caduIndex() && caduIndex.load(indexPath) && caduIndex.matches(softBits.length(), configuration.oqpsk, configuration.differentialDecode, configuration.deInterleave)) {
+                std::cout << "Decoding indexed frames from " << indexPath << std::endl;
+                decodedPacketCounter = meteorDecoder.decodeIndexed([&softBits](uint64_t pos, size_t length, uint8_t* output) {
+                    softBits.copy(pos, length, output);
+                }, softBits.length(), caduIndex.getEntries(rangeStart, rangeEnd));
+            } else {
+                // Two soft bits per symbol, the start has to stay on a symbol boundary
+                const double softBitsPerSec = mSettings.getSymbolRate() * 2.0;
+                const uint64_t start = static_cast<uint64_t>(std::min<double>(softBits.length(), rangeStart * softBitsPerSec)) & ~uint64_t(1);
+                const uint64_t end = static_cast<uint64_t>(std::min<double>(softBits.length(), rangeEnd * softBitsPerSec));
+
+                // Only the range is read, a packed input is unpacked chunk by chunk
+                std::vector<uint8_t> buffer;
+                for(uint64_t pos = start; pos < end; pos += SOFT_BITS_CHUNK) {
+                    const size_t length = std::min<uint64_t>(SOFT_BITS_CHUNK, end - pos);
+                    meteorDecoder.push(softBits.read(pos, length, buffer), length);
+                }
+                decodedPacketCounter = meteorDecoder.finish();
+
+                // Positions are only valid for the whole recording
+                if(mSettings.caduIndex() && !hasRange && decodedPacketCounter > 0) {
+                    caduIndex.header.symbolRate = mSettings.getSymbolRate();
+                    caduIndex.header.oqpsk = configuration.oqpsk;
+                    caduIndex.header.differentialDecode = configuration.differentialDecode;
+                    caduIndex.header.deInterleave = configuration.deInterleave;
+                    caduIndex.header.captureTime = mSettings.getPassDate().Ticks();
+                    caduIndex.header.softBitsLength = softBits.length();
+                    caduIndex.entries = meteorDecoder.getConfirmedFrames();
+
+                    if(!caduIndex.save(indexPath)) {
+                        std::cout << "Unable to write CADU index: " << indexPath << std::endl;
+                    }
+                }
+            }
+
+            meteorDecoder.setFrameJournal(nullptr);
+            frameJournal.close();
+        }
     } catch(std::exception ex) {
         std::cout << ex.what() << std::endl;
     }
@@ -168,11 +321,10 @@ int main(int argc, char* argv[]) {
 
             cv::Mat ch64 = meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
             cv::Mat ch65 = meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
-            cv::Mat ch68 = meteorDecoder.getChannelImage(PacketParser::APID_68, mSettings.fillBackLines());
 
             saveImage(mSettings.getOutputPath() + fileNameDate + "_64.bmp", ch64);
             saveImage(mSettings.getOutputPath() + fileNameDate + "_65.bmp", ch65);
-            saveImage(mSettings.getOutputPath() + fileNameDate + "_68.bmp", ch68);
+            saveImage(mSettings.getOutputPath() + fileNameDate + "_68.bmp", irImage);
 
             cv::Mat thermalRef = cv::imread(mSettings.getResourcesPath() + "thermal_ref.bmp");
             cv::Mat thermalImage = ThreatImage::irToTemperature(irImage, thermalRef);
@@ -205,10 +357,6 @@ int main(int argc, char* argv[]) {
                 std::cout << "Night pass, RGB image skipped, threshold set to: " << mSettings.getNightPassTreshold() << std::endl;
             }
 
-            meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
-            meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
-            meteorDecoder.getChannelImage(PacketParser::APID_66, mSettings.fillBackLines());
-
             cv::Mat ch64 = meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
             cv::Mat ch65 = meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
             cv::Mat ch66 = meteorDecoder.getChannelImage(PacketParser::APID_66, mSettings.fillBackLines());
@@ -216,39 +364,6 @@ int main(int argc, char* argv[]) {
             saveImage(mSettings.getOutputPath() + fileNameDate + "_64.bmp", ch64);
             saveImage(mSettings.getOutputPath() + fileNameDate + "_65.bmp", ch65);
             saveImage(mSettings.getOutputPath() + fileNameDate + "_66.bmp", ch66);
-        } else if(meteorDecoder.isChannel64Available() && meteorDecoder.isChannel65Available()) {
-            cv::Mat threatedImage = meteorDecoder.getRGBImage(PacketParser::APID_65, PacketParser::APID_65, PacketParser::APID_64, mSettings.fillBackLines());
-
-            if(!ThreatImage::isNightPass(threatedImage, mSettings.getNightPassTreshold())) {
-                threatedImage = ThreatImage::sharpen(threatedImage);
-
-                imagesToSpread.push_back(ImageForSpread(threatedImage, "221_"));
-                saveImage(mSettings.getOutputPath() + fileNameDate + "_221.bmp", threatedImage);
-            } else {
-                std::cout << "Night pass, RGB image skipped, threshold set to: " << mSettings.getNightPassTreshold() << std::endl;
-            }
-
-            cv::Mat ch64 = meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
-            cv::Mat ch65 = meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
-
-            saveImage(mSettings.getOutputPath() + fileNameDate + "_64.bmp", ch64);
-            saveImage(mSettings.getOutputPath() + fileNameDate + "_65.bmp", ch65);
-        } else if(meteorDecoder.isChannel68Available()) {
-            cv::Mat ch68 = meteorDecoder.getChannelImage(PacketParser::APID_68, mSettings.fillBackLines());
-            saveImage(mSettings.getOutputPath() + fileNameDate + "_68.bmp", ch68);
-
-            cv::Mat rainRef = cv::imread(mSettings.getResourcesPath() + "rain.bmp");
-            cv::Mat rainOverlay = ThreatImage::irToRain(ch68, rainRef);
-
-            ch68 = ThreatImage::invertIR(ch68);
-            ch68 = ThreatImage::gamma(ch68, 1.4);
-            ch68 = ThreatImage::contrast(ch68, 1.3, -40);
-            ch68 = ThreatImage::sharpen(ch68);
-            imagesToSpread.push_back(ImageForSpread(ch68, "IR_"));
-
-            if(mSettings.addRainOverlay()) {
-                imagesToSpread.push_back(ImageForSpread(ThreatImage::addRainOverlay(ch68, rainOverlay), "rain_IR_"));
-            }
         } else if(meteorDecoder.isChannel64Available() && meteorDecoder.isChannel65Available() && meteorDecoder.isChannel67Available()) {
             cv::Mat threatedImage1 = meteorDecoder.getRGBImage(PacketParser::APID_65, PacketParser::APID_65, PacketParser::APID_64, mSettings.fillBackLines());
             cv::Mat irImage = meteorDecoder.getChannelImage(PacketParser::APID_67, mSettings.fillBackLines());
@@ -277,11 +392,10 @@ int main(int argc, char* argv[]) {
 
             cv::Mat ch64 = meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
             cv::Mat ch65 = meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
-            cv::Mat ch68 = meteorDecoder.getChannelImage(PacketParser::APID_67, mSettings.fillBackLines());
 
             saveImage(mSettings.getOutputPath() + fileNameDate + "_64.bmp", ch64);
             saveImage(mSettings.getOutputPath() + fileNameDate + "_65.bmp", ch65);
-            saveImage(mSettings.getOutputPath() + fileNameDate + "_67.bmp", ch68);
+            saveImage(mSettings.getOutputPath() + fileNameDate + "_67.bmp", irImage);
 
             cv::Mat thermalRef = cv::imread(mSettings.getResourcesPath() + "thermal_ref.bmp");
             cv::Mat thermalImage = ThreatImage::irToTemperature(irImage, thermalRef);
@@ -296,6 +410,39 @@ int main(int argc, char* argv[]) {
             if(mSettings.addRainOverlay()) {
                 imagesToSpread.push_back(ImageForSpread(ThreatImage::addRainOverlay(irImage, rainOverlay), "rain_IR_"));
             }
+        } else if(meteorDecoder.isChannel64Available() && meteorDecoder.isChannel65Available()) {
+            cv::Mat threatedImage = meteorDecoder.getRGBImage(PacketParser::APID_65, PacketParser::APID_65, PacketParser::APID_64, mSettings.fillBackLines());
+
+            if(!ThreatImage::isNightPass(threatedImage, mSettings.getNightPassTreshold())) {
+                threatedImage = ThreatImage::sharpen(threatedImage);
+
+                imagesToSpread.push_back(ImageForSpread(threatedImage, "221_"));
+                saveImage(mSettings.getOutputPath() + fileNameDate + "_221.bmp", threatedImage);
+            } else {
+                std::cout << "Night pass, RGB image skipped, threshold set to: " << mSettings.getNightPassTreshold() << std::endl;
+            }
+
+            cv::Mat ch64 = meteorDecoder.getChannelImage(PacketParser::APID_64, mSettings.fillBackLines());
+            cv::Mat ch65 = meteorDecoder.getChannelImage(PacketParser::APID_65, mSettings.fillBackLines());
+
+            saveImage(mSettings.getOutputPath() + fileNameDate + "_64.bmp", ch64);
+            saveImage(mSettings.getOutputPath() + fileNameDate + "_65.bmp", ch65);
+        } else if(meteorDecoder.isChannel68Available()) {
+            cv::Mat ch68 = meteorDecoder.getChannelImage(PacketParser::APID_68, mSettings.fillBackLines());
+            saveImage(mSettings.getOutputPath() + fileNameDate + "_68.bmp", ch68);
+
+            cv::Mat rainRef = cv::imread(mSettings.getResourcesPath() + "rain.bmp");
+            cv::Mat rainOverlay = ThreatImage::irToRain(ch68, rainRef);
+
+            ch68 = ThreatImage::invertIR(ch68);
+            ch68 = ThreatImage::gamma(ch68, 1.4);
+            ch68 = ThreatImage::contrast(ch68, 1.3, -40);
+            ch68 = ThreatImage::sharpen(ch68);
+            imagesToSpread.push_back(ImageForSpread(ch68, "IR_"));
+
+            if(mSettings.addRainOverlay()) {
+                imagesToSpread.push_back(ImageForSpread(ThreatImage::addRainOverlay(ch68, rainOverlay), "rain_IR_"));
+            }
         } else {
             std::cout << "No usable channel data found!" << std::endl;
 
@@ -627,8 +774,38 @@ void saveImage(const std::string fileName, const cv::Mat& image) {
 void writeSymbolToFile(std::ostream& stream, const Wavreader::complex& sample) {
     int8_t outBuffer[2];
 
-    outBuffer[0] = static_cast<int8_t>(std::clamp(std::imag(sample) * 127.0f, -128.0f, 127.0f));
-    outBuffer[1] = static_cast<int8_t>(std::clamp(std::real(sample) * 127.0f, -128.0f, 127.0f));
+    DSP::MeteorDemodulator::symbolToSoftBits(sample, outBuffer);
 
     stream.write(reinterpret_cast<char*>(outBuffer), sizeof(outBuffer));
 }
+
+bool SoftBitsInput::open(const std::string& path) {
+    if(!file.open(path)) {
+        return false;
+    }
+
+    isPacked = PackedSoftBits::isPackedPath(path);
+    return !isPacked || packed.open(file.data(), file.size());
+}
+
+uint64_t SoftBitsInput::length() const {
+    return isPacked ? packed.length() : file.size();
+}
+
+const uint8_t* SoftBitsInput::read(uint64_t pos, size_t length, std::vector<uint8_t>& buffer) const {
+    if(!isPacked) {
+        return file.data() + pos;
+    }
+
+    buffer.resize(length);
+    packed.read(pos, length, buffer.data());
+    return buffer.data();
+}
+
+void SoftBitsInput::copy(uint64_t pos, size_t length, uint8_t* softBits) const {
+    if(isPacked) {
+        packed.read(pos, length, softBits);
+    } else {
+        memcpy(softBits, file.data() + pos, length);
+    }
+}
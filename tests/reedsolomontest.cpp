@@ -0,0 +1,242 @@
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpufeatures.h"
+#include "reedsolomon.h"
+
+namespace {
+
+// CCSDS code in conventional basis, written independently of the decoder's tables
+const uint16_t POLYNOMIAL = 0x187;
+const int FIRST_ROOT = 112;
+const int ROOT_GAP = 11;
+
+const int INTERLEAVING = ReedSolomon::INTERLEAVING;
+const int BLOCK_LENGTH = ReedSolomon::BLOCK_LENGTH;
+const int MESSAGE_LENGTH = ReedSolomon::MESSAGE_LENGTH;
+const int ROOTS = ReedSolomon::ROOTS;
+const int CORRECTABLE = ROOTS / 2;
+const int CADU_DATA_LENGTH = INTERLEAVING * BLOCK_LENGTH;
+
+struct Kernel {
+    std::string name;
+    void (*syndromes)(const uint8_t*, uint8_t[ReedSolomon::INTERLEAVING][ReedSolomon::ROOTS]);
+};
+
+class Encoder {
+  public:
+    Encoder() {
+        uint16_t x = 1;
+        for(int i = 0; i < 255; i++) {
+            mExp[i] = mExp[i + 255] = static_cast<uint8_t>(x);
+            mLog[x] = static_cast<uint8_t>(i);
+            x <<= 1;
+            if(x & 0x100) {
+                x ^= POLYNOMIAL;
+            }
+        }
+
+        // g(x) = (x - a^(ROOT_GAP * FIRST_ROOT)) ... (x - a^(ROOT_GAP * (FIRST_ROOT + ROOTS - 1))), lowest degree first
+        uint8_t generator[ROOTS + 1] = {1};
+        for(int j = 0; j < ROOTS; j++) {
+            const uint8_t root = mExp[(ROOT_GAP * (FIRST_ROOT + j)) % 255];
+            for(int i = j + 1; i > 0; i--) {
+                generator[i] = generator[i - 1] ^ mul(generator[i], root);
+            }
+            generator[0] = mul(generator[0], root);
+        }
+        memcpy(mGenerator, generator, sizeof(mGenerator));
+    }
+
+    // Systematic codeword, the message is followed by the parity, highest degree first
+    void encode(const uint8_t* message, uint8_t* codeword) const {
+        uint8_t parity[ROOTS] = {0};
+        for(int k = 0; k < MESSAGE_LENGTH; k++) {
+            const uint8_t feedback = message[k] ^ parity[ROOTS - 1];
+            for(int i = ROOTS - 1; i > 0; i--) {
+                parity[i] = parity[i - 1] ^ mul(feedback, mGenerator[i]);
+            }
+            parity[0] = mul(feedback, mGenerator[0]);
+        }
+
+        memcpy(codeword, message, MESSAGE_LENGTH);
+        for(int i = 0; i < ROOTS; i++) {
+            codeword[MESSAGE_LENGTH + i] = parity[ROOTS - 1 - i];
+        }
+    }
+
+  private:
+    uint8_t mul(uint8_t a, uint8_t b) const {
+        return (a == 0 || b == 0) ? 0 : mExp[mLog[a] + mLog[b]];
+    }
+
+  private:
+    uint8_t mExp[510];
+    uint8_t mLog[256];
+    uint8_t mGenerator[ROOTS + 1];
+};
+
+} // namespace
+
+class ReedSolomonTest {
+  public:
+    ReedSolomonTest()
+        : mRandom(33)
+        , mFailures(0) {
+        mKernels.push_back({"scalar", ReedSolomon::syndromesScalar});
+#if defined(CPU_FEATURES_X86)
+        if(CpuFeatures::hasSSSE3()) {
+            mKernels.push_back({"ssse3", ReedSolomon::syndromesSSSE3});
+        }
+        if(CpuFeatures::hasAVX2()) {
+            mKernels.push_back({"avx2", ReedSolomon::syndromesAVX2});
+        }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+        mKernels.push_back({"neon", ReedSolomon::syndromesNEON});
+#endif
+    }
+
+    int run() {
+        std::cout << "Kernels:";
+        for(const auto& kernel : mKernels) {
+            std::cout << " " << kernel.name;
+        }
+        std::cout << std::endl;
+
+        testSyndromes();
+        testCorrection();
+
+        std::cout << (mFailures == 0 ? "All tests passed" : "Tests failed: " + std::to_string(mFailures)) << std::endl;
+        return mFailures == 0 ? 0 : 1;
+    }
+
+  private:
+    // Every SIMD kernel against the scalar one, on codewords and on arbitrary data
+    void testSyndromes() {
+        std::vector<uint8_t> data(CADU_DATA_LENGTH);
+        uint8_t expected[INTERLEAVING][ROOTS];
+        uint8_t syndromes[INTERLEAVING][ROOTS];
+
+        for(int trial = 0; trial < 200; trial++) {
+            if(trial % 2 == 0) {
+                randomCadu(data);
+                addErrors(data, trial % (CORRECTABLE + 1));
+            } else {
+                for(auto& byte : data) {
+                    byte = static_cast<uint8_t>(mRandom());
+                }
+            }
+
+            ReedSolomon::syndromesScalar(data.data(), expected);
+            for(const auto& kernel : mKernels) {
+                kernel.syndromes(data.data(), syndromes);
+                if(memcmp(syndromes, expected, sizeof(expected)) != 0) {
+                    fail("syndromes " + kernel.name + " trial " + std::to_string(trial));
+                }
+            }
+        }
+    }
+
+    // 0 to CORRECTABLE errors have to be corrected exactly, more have to be reported as not correctable
+    void testCorrection() {
+        std::vector<uint8_t> original(CADU_DATA_LENGTH);
+        std::vector<uint8_t> data(CADU_DATA_LENGTH);
+
+        for(const auto& kernel : mKernels) {
+            ReedSolomon reedSolomon;
+            reedSolomon.mSyndromes = kernel.syndromes;
+
+            for(int trial = 0; trial < 300; trial++) {
+                randomCadu(original);
+                data = original;
+
+                int errors[INTERLEAVING];
+                for(int c = 0; c < INTERLEAVING; c++) {
+                    // Every count up to the limit, then a few past it
+                    errors[c] = (trial * INTERLEAVING + c) % (CORRECTABLE + 9);
+                    addErrors(data, c, errors[c]);
+                }
+
+                int results[INTERLEAVING];
+                reedSolomon.decodeInterleaved(data.data(), results);
+
+                for(int c = 0; c < INTERLEAVING; c++) {
+                    const std::string description = kernel.name + " trial " + std::to_string(trial) + " codeword " + std::to_string(c) + " errors " + std::to_string(errors[c]);
+                    if(errors[c] <= CORRECTABLE) {
+                        if(results[c] != errors[c]) {
+                            fail("count " + description + " result " + std::to_string(results[c]));
+                        } else if(!codewordEquals(data, original, c)) {
+                            fail("correction " + description);
+                        }
+                    } else if(results[c] != -1) {
+                        fail("uncorrectable " + description + " result " + std::to_string(results[c]));
+                    }
+                }
+            }
+        }
+    }
+
+    void randomCadu(std::vector<uint8_t>& data) {
+        uint8_t message[MESSAGE_LENGTH];
+        uint8_t codeword[BLOCK_LENGTH];
+
+        for(int c = 0; c < INTERLEAVING; c++) {
+            for(auto& byte : message) {
+                byte = static_cast<uint8_t>(mRandom());
+            }
+            mEncoder.encode(message, codeword);
+            for(int k = 0; k < BLOCK_LENGTH; k++) {
+                data[k * INTERLEAVING + c] = codeword[k];
+            }
+        }
+    }
+
+    void addErrors(std::vector<uint8_t>& data, int count) {
+        for(int c = 0; c < INTERLEAVING; c++) {
+            addErrors(data, c, count);
+        }
+    }
+
+    // Distinct symbols of codeword c get a non-zero error
+    void addErrors(std::vector<uint8_t>& data, int c, int count) {
+        std::vector<int> positions(BLOCK_LENGTH);
+        for(int k = 0; k < BLOCK_LENGTH; k++) {
+            positions[k] = k;
+        }
+        for(int i = 0; i < count; i++) {
+            std::swap(positions[i], positions[i + mRandom() % (BLOCK_LENGTH - i)]);
+            data[positions[i] * INTERLEAVING + c] ^= static_cast<uint8_t>(1 + mRandom() % 255);
+        }
+    }
+
+    static bool codewordEquals(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int c) {
+        for(int k = 0; k < BLOCK_LENGTH; k++) {
+            if(a[k * INTERLEAVING + c] != b[k * INTERLEAVING + c]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void fail(const std::string& description) {
+        std::cout << "Mismatch: " << description << std::endl;
+        mFailures++;
+    }
+
+  private:
+    Encoder mEncoder;
+    std::vector<Kernel> mKernels;
+    std::mt19937 mRandom;
+    int mFailures;
+};
+
+int main() {
+    ReedSolomonTest test;
+    return test.run();
+}
@@ -0,0 +1,245 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpufeatures.h"
+#include "viterbi.h"
+
+namespace {
+
+const int K = 7;
+const uint8_t POLYNOM_A = 0x4F;
+const uint8_t POLYNOM_B = 0x6D;
+
+// Same frame size as the decoder uses
+const size_t FRAME_STEPS = 8192;
+const size_t FRAME_SOFT_BITS = FRAME_STEPS * 2;
+const size_t MESSAGE_BITS = FRAME_STEPS - (K - 1);
+const size_t MESSAGE_BYTES = (MESSAGE_BITS + 7) / 8;
+
+// Noise below this level never causes a bit error, so the unterminated stream decoding has to give the same bits as libcorrect
+const int STREAM_EXACT_SIGMA = 60;
+
+enum class Distortion { Gaussian, Hard, Coarse, Random };
+
+struct Kernel {
+    std::string name;
+    void (*acs)(const uint8_t*, size_t, int16_t*, uint64_t*);
+};
+
+int parity(int value) {
+    value ^= value >> 4;
+    value ^= value >> 2;
+    value ^= value >> 1;
+    return value & 1;
+}
+
+// Box-Muller on the raw generator output, the std distributions differ between standard libraries
+double gaussian(std::mt19937& random) {
+    const double u1 = (random() + 0.5) / 4294967296.0;
+    const double u2 = (random() + 0.5) / 4294967296.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// Terminated frame, the register starts and ends with zeros like libcorrect expects
+void encodeFrame(const std::vector<uint8_t>& messageBits, uint8_t* softBits) {
+    int reg = 0;
+    for(size_t i = 0; i < FRAME_STEPS; i++) {
+        const int bit = i < MESSAGE_BITS ? messageBits[i] : 0;
+        reg = ((reg << 1) | bit) & ((1 << K) - 1);
+        softBits[i * 2] = parity(reg & POLYNOM_A) ? 255 : 0;
+        softBits[i * 2 + 1] = parity(reg & POLYNOM_B) ? 255 : 0;
+    }
+}
+
+void distort(uint8_t* softBits, size_t length, Distortion distortion, double sigma, std::mt19937& random) {
+    for(size_t i = 0; i < length; i++) {
+        const double value = softBits[i] + sigma * gaussian(random);
+        uint8_t soft = static_cast<uint8_t>(std::min(255.0, std::max(0.0, round(value))));
+
+        switch(distortion) {
+            case Distortion::Gaussian:
+                break;
+            case Distortion::Hard:
+                // Many equal path metrics, checks the tie breaking
+                soft = soft > 127 ? 255 : 0;
+                break;
+            case Distortion::Coarse:
+                soft = (soft & 0xF0) | 0x08;
+                break;
+            case Distortion::Random:
+                soft = static_cast<uint8_t>(random());
+                break;
+        }
+        softBits[i] = soft;
+    }
+}
+
+std::vector<uint8_t> randomMessage(std::mt19937& random) {
+    std::vector<uint8_t> bits(MESSAGE_BITS);
+    for(auto& bit : bits) {
+        bit = random() & 1;
+    }
+    return bits;
+}
+
+} // namespace
+
+class ViterbiTest {
+  public:
+    ViterbiTest()
+        : mRandom(31)
+        , mFailures(0) {
+        correct_convolutional_polynomial_t polynomials[2] = {POLYNOM_A, POLYNOM_B};
+        mpConvolutional = correct_convolutional_create(2, K, polynomials);
+
+        mKernels.push_back({"scalar", Viterbi::acsScalar});
+#if defined(CPU_FEATURES_X86)
+        if(CpuFeatures::hasSSE2()) {
+            mKernels.push_back({"sse2", Viterbi::acsSSE2});
+        }
+        if(CpuFeatures::hasAVX2()) {
+            mKernels.push_back({"avx2", Viterbi::acsAVX2});
+        }
+#elif defined(CPU_FEATURES_NEON) && defined(__aarch64__)
+        mKernels.push_back({"neon", Viterbi::acsNEON});
+#endif
+    }
+
+    ~ViterbiTest() {
+        correct_convolutional_destroy(mpConvolutional);
+    }
+
+    int run() {
+        std::cout << "Kernels:";
+        for(const auto& kernel : mKernels) {
+            std::cout << " " << kernel.name;
+        }
+        std::cout << std::endl;
+
+        testBlock();
+        testStream();
+
+        std::cout << (mFailures == 0 ? "All tests passed" : "Tests failed: " + std::to_string(mFailures)) << std::endl;
+        return mFailures == 0 ? 0 : 1;
+    }
+
+  private:
+    // decodeSoft() of every kernel against correct_convolutional_decode_soft() on the same frame
+    void testBlock() {
+        const Distortion distortions[] = {Distortion::Gaussian, Distortion::Hard, Distortion::Coarse};
+        std::vector<uint8_t> softBits(FRAME_SOFT_BITS);
+        std::vector<uint8_t> expected(MESSAGE_BYTES);
+        std::vector<uint8_t> result(MESSAGE_BYTES);
+
+        for(Distortion distortion : distortions) {
+            for(int sigma = 0; sigma <= 175; sigma += 25) {
+                for(int frame = 0; frame < 2; frame++) {
+                    encodeFrame(randomMessage(mRandom), softBits.data());
+                    distort(softBits.data(), softBits.size(), distortion, sigma, mRandom);
+                    checkBlock(softBits, expected, result, "sigma " + std::to_string(sigma));
+                }
+            }
+        }
+
+        for(int frame = 0; frame < 2; frame++) {
+            distort(softBits.data(), softBits.size(), Distortion::Random, 0.0, mRandom);
+            checkBlock(softBits, expected, result, "random");
+        }
+    }
+
+    void checkBlock(const std::vector<uint8_t>& softBits, std::vector<uint8_t>& expected, std::vector<uint8_t>& result, const std::string& description) {
+        const ssize_t expectedLength = correct_convolutional_decode_soft(mpConvolutional, softBits.data(), softBits.size(), expected.data());
+
+        for(const auto& kernel : mKernels) {
+            Viterbi viterbi;
+            viterbi.mAcs = kernel.acs;
+            std::fill(result.begin(), result.end(), 0xAA);
+
+            const size_t length = viterbi.decodeSoft(softBits.data(), result.data(), softBits.size());
+            if(static_cast<ssize_t>(length) != expectedLength || memcmp(result.data(), expected.data(), length) != 0) {
+                fail("block " + kernel.name + " " + description);
+            }
+        }
+    }
+
+    // decodeStream() and flushStream() over consecutive terminated frames fed in uneven chunks
+    void testStream() {
+        const size_t frameCount = 6;
+
+        for(int sigma = 0; sigma <= 150; sigma += 30) {
+            std::vector<uint8_t> softBits(frameCount * FRAME_SOFT_BITS);
+            std::vector<uint8_t> expected;
+            std::vector<uint8_t> message(MESSAGE_BYTES);
+
+            for(size_t frame = 0; frame < frameCount; frame++) {
+                uint8_t* frameSoftBits = &softBits[frame * FRAME_SOFT_BITS];
+                encodeFrame(randomMessage(mRandom), frameSoftBits);
+                distort(frameSoftBits, FRAME_SOFT_BITS, Distortion::Gaussian, sigma, mRandom);
+
+                correct_convolutional_decode_soft(mpConvolutional, frameSoftBits, FRAME_SOFT_BITS, message.data());
+                for(size_t i = 0; i < FRAME_STEPS; i++) {
+                    expected.push_back(i < MESSAGE_BITS ? (message[i / 8] >> (7 - i % 8)) & 1 : 0);
+                }
+            }
+
+            std::vector<size_t> chunks;
+            for(size_t pos = 0; pos < softBits.size();) {
+                const size_t chunk = std::min<size_t>(softBits.size() - pos, (mRandom() % 2000) * 2);
+                chunks.push_back(chunk);
+                pos += chunk;
+            }
+
+            std::vector<uint8_t> scalarBits;
+            for(const auto& kernel : mKernels) {
+                Viterbi viterbi;
+                viterbi.mAcs = kernel.acs;
+                viterbi.resetStream();
+
+                std::vector<uint8_t> bits;
+                size_t pos = 0;
+                for(size_t chunk : chunks) {
+                    viterbi.decodeStream(&softBits[pos], chunk, bits);
+                    pos += chunk;
+                }
+                viterbi.flushStream(bits);
+
+                const std::string description = "stream " + kernel.name + " sigma " + std::to_string(sigma);
+                if(bits.size() != expected.size()) {
+                    fail(description + " length");
+                } else if(sigma <= STREAM_EXACT_SIGMA && bits != expected) {
+                    fail(description + " differs from libcorrect");
+                }
+
+                // Above the exact limit the kernels still have to agree with each other
+                if(scalarBits.empty()) {
+                    scalarBits = bits;
+                } else if(bits != scalarBits) {
+                    fail(description + " differs from scalar");
+                }
+            }
+        }
+    }
+
+    void fail(const std::string& description) {
+        std::cout << "Mismatch: " << description << std::endl;
+        mFailures++;
+    }
+
+  private:
+    correct_convolutional* mpConvolutional;
+    std::vector<Kernel> mKernels;
+    std::mt19937 mRandom;
+    int mFailures;
+};
+
+int main() {
+    ViterbiTest test;
+    return test.run();
+}
@@ -0,0 +1,71 @@
+#include "cpufeatures.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+CpuFeatures::CpuFeatures() {}
+
+bool CpuFeatures::hasSSE2() {
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    static const bool supported = __builtin_cpu_supports("sse2");
+    return supported;
+#elif defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+    static const bool supported = []() {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool CpuFeatures::hasSSSE3() {
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+#elif defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+    static const bool supported = []() {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool CpuFeatures::hasAVX2() {
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#elif defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+    static const bool supported = []() {
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7) {
+            return false;
+        }
+
+        // The OS has to save the YMM registers as well
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if(!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
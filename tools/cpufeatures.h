@@ -0,0 +1,31 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_FEATURES_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CPU_FEATURES_NEON
+#endif
+
+// Functions using AVX2 intrinsics are compiled with this attribute and only called after hasAVX2() returned true
+#if defined(CPU_FEATURES_X86) && defined(__GNUC__)
+#define CPU_FEATURES_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define CPU_FEATURES_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_FEATURES_TARGET_SSSE3
+#define CPU_FEATURES_TARGET_AVX2
+#endif
+
+class CpuFeatures {
+  private:
+    CpuFeatures();
+
+  public:
+    static bool hasSSE2();
+    static bool hasSSSE3();
+    static bool hasAVX2();
+};
+
+#endif // CPUFEATURES_H
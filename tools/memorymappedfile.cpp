@@ -0,0 +1,175 @@
+#include "memorymappedfile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MemoryMappedFile::MemoryMappedFile()
+    : mData(nullptr)
+    , mSize(0)
+    , mIsOpen(false)
+#if defined(_WIN32)
+    , mFileHandle(INVALID_HANDLE_VALUE)
+    , mMappingHandle(nullptr)
+#endif
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MemoryMappedFile::open(const std::string& path) {
+    close();
+
+    mFileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(mFileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(mFileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    mSize = static_cast<size_t>(fileSize.QuadPart);
+    mIsOpen = true;
+
+    // Empty files can not be mapped
+    if(mSize == 0) {
+        return true;
+    }
+
+    mMappingHandle = CreateFileMappingA(mFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mMappingHandle == nullptr) {
+        close();
+        return false;
+    }
+
+    mData = static_cast<uint8_t*>(MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(mData == nullptr) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool MemoryMappedFile::allocate(size_t size) {
+    close();
+
+    mSize = size;
+    mIsOpen = true;
+
+    if(mSize == 0) {
+        return true;
+    }
+
+    mData = static_cast<uint8_t*>(VirtualAlloc(nullptr, mSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if(mData == nullptr) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MemoryMappedFile::close() {
+    if(mData != nullptr) {
+        if(mMappingHandle != nullptr) {
+            UnmapViewOfFile(mData);
+        } else {
+            VirtualFree(mData, 0, MEM_RELEASE);
+        }
+    }
+    if(mMappingHandle != nullptr) {
+        CloseHandle(mMappingHandle);
+    }
+    if(mFileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(mFileHandle);
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mIsOpen = false;
+    mFileHandle = INVALID_HANDLE_VALUE;
+    mMappingHandle = nullptr;
+}
+
+#else
+
+bool MemoryMappedFile::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0) {
+        ::close(fd);
+        return false;
+    }
+    mSize = static_cast<size_t>(fileStat.st_size);
+    mIsOpen = true;
+
+    // Empty files can not be mapped
+    if(mSize == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* data = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if(data == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    mData = static_cast<uint8_t*>(data);
+    madvise(mData, mSize, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+bool MemoryMappedFile::allocate(size_t size) {
+    close();
+
+    mSize = size;
+    mIsOpen = true;
+
+    if(mSize == 0) {
+        return true;
+    }
+
+    void* data = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(data == MAP_FAILED) {
+        close();
+        return false;
+    }
+
+    mData = static_cast<uint8_t*>(data);
+
+    return true;
+}
+
+void MemoryMappedFile::close() {
+    if(mData != nullptr) {
+        munmap(mData, mSize);
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mIsOpen = false;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MEMORYMAPPEDFILE_H
+#define MEMORYMAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+class MemoryMappedFile {
+  public:
+    MemoryMappedFile();
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    // Read only mapping of an existing file, the kernel is advised for sequential access
+    bool open(const std::string& path);
+
+    // Anonymous read/write mapping, used as output buffer
+    bool allocate(size_t size);
+
+    void close();
+
+    bool isOpen() const {
+        return mIsOpen;
+    }
+
+    const uint8_t* data() const {
+        return mData;
+    }
+
+    uint8_t* data() {
+        return mData;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+  private:
+    uint8_t* mData;
+    size_t mSize;
+    bool mIsOpen;
+#if defined(_WIN32)
+    void* mFileHandle;
+    void* mMappingHandle;
+#endif
+};
+
+#endif // MEMORYMAPPEDFILE_H
@@ -47,6 +47,14 @@ void ThreadPool::addJob(JobFunction_t task) {
     mConditionVariable.notify_one();
 }
 
+void ThreadPool::addJob(JobFunction_t task, JobCounter& counter) {
+    counter++;
+    addJob([task, &counter]() {
+        task();
+        counter--;
+    });
+}
+
 void ThreadPool::threadLoop() {
     JobFunction_t job;
 
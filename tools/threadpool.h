@@ -13,7 +13,8 @@
 
 
 class ThreadPool {
-  private:
+  public:
+    // Counts the outstanding jobs of one owner, so the owner can wait for its own jobs instead of the whole pool
     class JobCounter {
       public:
         JobCounter(int count_ = 0)
@@ -71,6 +72,9 @@ class ThreadPool {
 
     void addJob(JobFunction_t task);
 
+    // The counter is incremented now and decremented when the job finished, it has to outlive the job
+    void addJob(JobFunction_t task, JobCounter& counter);
+
     template <typename T>
     void addJob(void (T::*handler)(), T* instance) {
         addJob(std::bind(handler, instance));
@@ -80,6 +84,10 @@ class ThreadPool {
         return mJobCounter.getCount();
     }
 
+    int getNumberOfThreads() const {
+        return mNumberOfThreads;
+    }
+
   private:
     int mNumberOfThreads;
     bool mIsRuning;